@@ -0,0 +1,560 @@
+//
+//  AssetLoader.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+#define LOG(argument) std::cout << argument << '\n'
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "AssetLoader.h"
+#include "BlockCompression.h"
+#include "SoftwareRenderer.h"
+#include "stb_image.h"
+
+const int NUMBER_OF_TEXTURES = 1; // to be generated, that is
+const GLint LEVEL_OF_DETAIL  = 0;  // base image level; Level n is the nth mipmap reduction image
+const GLint TEXTURE_BORDER   = 0;   // this value MUST be zero
+
+const size_t DEFAULT_UPLOAD_BUDGET = 1024 * 1024;   // bytes of texels sent to GL per PumpTextures()
+
+AssetLoader::AssetLoader(int threadCount, SoftwareRenderer *softwareRenderer, bool coreProfile)
+    : pool(threadCount), completedTextures(NULL), completedAudio(NULL), pending(0), coreProfile(coreProfile), softwareRenderer(softwareRenderer)
+{
+    if (softwareRenderer == NULL)
+    {
+        uploader = new TextureUploader(DEFAULT_UPLOAD_BUDGET);
+
+        int major = 0, minor = 0;
+        const char *version = (const char *) glGetString(GL_VERSION);
+        if (version != NULL) sscanf(version, "%d.%d", &major, &minor);
+
+        s3tc = SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc");
+        bptc = major > 4 || (major == 4 && minor >= 2) || SDL_GL_ExtensionSupported("GL_ARB_texture_compression_bptc");
+    }
+}
+
+bool AssetLoader::SamplesBlocks(uint32_t format) const
+{
+    switch (format)
+    {
+        case COOKED_BC1:
+        case COOKED_BC3: return s3tc;
+        case COOKED_BC7: return bptc;
+    }
+    return false;
+}
+
+// BC1 as RGBA, though the cooker only writes opaque blocks, so GL reads
+// them the way decode_blocks() does
+static GLenum block_internal_format(uint32_t format)
+{
+    switch (format)
+    {
+        case COOKED_BC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case COOKED_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case COOKED_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+    }
+    return GL_RGBA;
+}
+
+AssetLoader::~AssetLoader()
+{
+    pool.Wait();
+
+    // Nothing is going to pick these up any more, just release them
+    Release(completedTextures);
+    Release(completedAudio);
+
+    delete uploader;
+    for (auto &entry : streaming)
+    {
+        unmap_cooked_texture(&entry.second->cooked);
+        if (entry.second->pixels != NULL) stbi_image_free(entry.second->pixels);
+        delete entry.second;
+    }
+
+    for (auto &entry : textures) glDeleteTextures(NUMBER_OF_TEXTURES, &entry.first);
+    for (auto &entry : palettes) glDeleteTextures(NUMBER_OF_TEXTURES, &entry.second.textureID);
+}
+
+void AssetLoader::Release(std::atomic<LoadedAsset*> &completed)
+{
+    LoadedAsset *asset = completed.exchange(NULL);
+    while (asset != NULL)
+    {
+        LoadedAsset *next = asset->next;
+        unmap_cooked_texture(&asset->cooked);
+        if (asset->pixels != NULL) stbi_image_free(asset->pixels);
+        if (asset->chunk != NULL)  Mix_FreeChunk(asset->chunk);
+        if (asset->music != NULL)  Mix_FreeMusic(asset->music);
+        delete asset;
+        asset = next;
+    }
+}
+
+GLuint AssetLoader::LoadTexture(const char *filepath)
+{
+    // The id exists right away so entities can hold on to it; until the real
+    // pixels arrive it samples as fully transparent
+    GLuint textureID;
+    if (softwareRenderer != NULL)
+    {
+        // The software renderer skips ids it has no pixels for yet
+        textureID = ++softwareTextureCount;
+    }
+    else
+    {
+        glGenTextures(NUMBER_OF_TEXTURES, &textureID);
+        SetPlaceholder(textureID);
+        textures[textureID] = { filepath, TEXTURE_LOADING, 0, 1, frame };
+    }
+
+    Decode(textureID, filepath);
+    return textureID;
+}
+
+void AssetLoader::SetPlaceholder(GLuint textureID)
+{
+    unsigned char placeholder[] = { 0, 0, 0, 0 };
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, 1, 1, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LEVEL_OF_DETAIL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void AssetLoader::Decode(GLuint textureID, const std::string &filepath)
+{
+    LoadedAsset *asset = new LoadedAsset();
+    asset->type = TEXTURE_ASSET;
+    asset->filepath = filepath;
+    asset->textureID = textureID;
+
+    pending++;
+    pool.Submit([this, asset] {
+        // Cooked data is already in its final form, so mapping it is all the
+        // work there is. One older than its image is ignored: the image was
+        // edited and nobody has run the cooker since.
+        std::string cookedPath = cooked_texture_path(asset->filepath);
+        if (cooked_texture_is_current(asset->filepath, cookedPath) && map_cooked_texture(cookedPath, &asset->cooked))
+        {
+            const MappedTexture &cooked = asset->cooked;
+            const CookedMipLevel &base = cooked.levels[0];
+            if (cooked.header->format == COOKED_INDEX8)
+            {
+                asset->coverage = classify_alpha_index8(cooked.data + base.offset, base.width * base.height,
+                                                        cooked.data + cooked.header->paletteOffset, cooked.header->paletteRows);
+            }
+            else if (is_block_compressed(cooked.header->format))
+            {
+                // Blocks GL can't take are all decoded; those it can still have
+                // their base level decoded, just for the alpha check. The
+                // software renderer only ever wants the base level.
+                bool uploadBlocks = SamplesBlocks(cooked.header->format);
+                uint32_t decodedLevels = uploadBlocks || softwareRenderer != NULL ? 1 : cooked.header->mipCount;
+                size_t bytes = 0;
+                for (uint32_t level = 0; level < decodedLevels; level++) bytes += (size_t) cooked.levels[level].width * cooked.levels[level].height * 4;
+                asset->decoded.resize(bytes);
+
+                unsigned char *destination = asset->decoded.data();
+                for (uint32_t level = 0; level < decodedLevels; level++)
+                {
+                    const CookedMipLevel &mip = cooked.levels[level];
+                    decode_blocks(cooked.header->format, cooked.data + mip.offset, mip.width, mip.height, destination);
+                    destination += (size_t) mip.width * mip.height * 4;
+                }
+                asset->coverage = classify_alpha_rgba8(asset->decoded.data(), base.width * base.height);
+
+                if (uploadBlocks) std::vector<unsigned char>().swap(asset->decoded);
+            }
+            else
+            {
+                asset->coverage = classify_alpha_rgba8(cooked.data + base.offset, base.width * base.height);
+            }
+        }
+        else
+        {
+            int number_of_components;
+            asset->pixels = stbi_load(asset->filepath.c_str(), &asset->width, &asset->height, &number_of_components, STBI_rgb_alpha);
+            if (asset->pixels != NULL)
+            {
+                premultiply_rgba8(asset->pixels, asset->width * asset->height);
+                asset->coverage = classify_alpha_rgba8(asset->pixels, asset->width * asset->height);
+            }
+        }
+        Complete(asset);
+    });
+}
+
+void AssetLoader::LoadSound(const char *filepath, Mix_Chunk **destination)
+{
+    LoadedAsset *asset = new LoadedAsset();
+    asset->type = SOUND_ASSET;
+    asset->filepath = filepath;
+    asset->chunkDestination = destination;
+
+    pending++;
+    pool.Submit([this, asset] {
+        asset->chunk = Mix_LoadWAV(asset->filepath.c_str());
+        Complete(asset);
+    });
+}
+
+void AssetLoader::LoadMusic(const char *filepath, Mix_Music **destination, void (*onLoaded)(Mix_Music *music))
+{
+    LoadedAsset *asset = new LoadedAsset();
+    asset->type = MUSIC_ASSET;
+    asset->filepath = filepath;
+    asset->musicDestination = destination;
+    asset->onMusicLoaded = onLoaded;
+
+    pending++;
+    pool.Submit([this, asset] {
+        asset->music = Mix_LoadMUS(asset->filepath.c_str());
+        Complete(asset);
+    });
+}
+
+void AssetLoader::Complete(LoadedAsset *asset)
+{
+    std::atomic<LoadedAsset*> &completed = asset->type == TEXTURE_ASSET ? completedTextures : completedAudio;
+
+    // Lock-free push; any number of workers may race here
+    LoadedAsset *head = completed.load(std::memory_order_relaxed);
+    do {
+        asset->next = head;
+    } while (!completed.compare_exchange_weak(head, asset, std::memory_order_release, std::memory_order_relaxed));
+}
+
+int AssetLoader::PumpTextures()
+{
+    int applied = Drain(completedTextures);
+    if (uploader != NULL) applied += FinishUploads();
+    return applied;
+}
+
+void AssetLoader::SetUploadBudget(size_t bytes)
+{
+    if (uploader != NULL) uploader->SetBytesPerFrame(bytes);
+}
+
+int AssetLoader::FinishUploads()
+{
+    finishedUploads.clear();
+    uploader->Pump(finishedUploads);
+
+    for (GLuint textureID : finishedUploads)
+    {
+        LoadedAsset *asset = streaming[textureID];
+        streaming.erase(textureID);
+        unmap_cooked_texture(&asset->cooked);
+        if (asset->pixels != NULL) stbi_image_free(asset->pixels);
+        delete asset;
+
+        auto found = textures.find(textureID);
+        if (found != textures.end()) found->second.residency = TEXTURE_RESIDENT;
+        pending--;
+    }
+    return (int) finishedUploads.size();
+}
+
+int AssetLoader::PumpAudio()
+{
+    return Drain(completedAudio);
+}
+
+int AssetLoader::Drain(std::atomic<LoadedAsset*> &completed)
+{
+    // Take the whole list in one go, then flip it back into completion order
+    LoadedAsset *asset = completed.exchange(NULL, std::memory_order_acquire);
+    LoadedAsset *ordered = NULL;
+    while (asset != NULL)
+    {
+        LoadedAsset *next = asset->next;
+        asset->next = ordered;
+        ordered = asset;
+        asset = next;
+    }
+
+    int applied = 0;
+    while (ordered != NULL)
+    {
+        LoadedAsset *next = ordered->next;
+        if (Apply(ordered))
+        {
+            delete ordered;
+            pending--;
+            applied++;
+        }
+        ordered = next;
+    }
+    return applied;
+}
+
+bool AssetLoader::Apply(LoadedAsset *asset)
+{
+    switch (asset->type)
+    {
+        case TEXTURE_ASSET:
+        {
+            TextureRecord *record = NULL;
+            auto found = textures.find(asset->textureID);
+            if (found != textures.end())
+            {
+                record = &found->second;
+                record->bytes = 0;
+            }
+
+            // A texture that failed to load stays a placeholder and is never retried
+            if (asset->cooked.data == NULL && asset->pixels == NULL)
+            {
+                LOG("Unable to load image " << asset->filepath << ". Make sure the path is correct.");
+                if (record != NULL) record->residency = TEXTURE_RESIDENT;
+                break;
+            }
+
+            if (softwareRenderer != NULL)
+            {
+                ApplySoftware(asset);
+                break;
+            }
+
+            // The pixels go in over the next few PumpTextures(), straight from
+            // the mapping or the decoded image, which live until they are in
+            if (asset->cooked.data != NULL)
+            {
+                // Indices are a single channel, whatever the context calls it
+                const MappedTexture &cooked = asset->cooked;
+                bool indexed = cooked.header->format == COOKED_INDEX8;
+                bool blocks = is_block_compressed(cooked.header->format) && asset->decoded.empty();
+                GLenum format = !indexed ? GL_RGBA : coreProfile ? GL_RED : GL_LUMINANCE;
+                GLint internalFormat = !indexed ? GL_RGBA : coreProfile ? GL_R8 : GL_LUMINANCE;
+
+                // Resident size is what GL keeps: the blocks themselves, or RGBA8 for decoded ones
+                size_t bytes = 0;
+                const unsigned char *decoded = asset->decoded.data();
+                for (uint32_t level = 0; level < cooked.header->mipCount; level++)
+                {
+                    const CookedMipLevel &mip = cooked.levels[level];
+                    if (blocks)
+                    {
+                        uploader->QueueBlocks(asset->textureID, level, block_internal_format(cooked.header->format), mip.width, mip.height,
+                                              cooked.header->format == COOKED_BC1 ? 8 : 16, cooked.data + mip.offset);
+                        bytes += mip.size;
+                    }
+                    else if (!asset->decoded.empty())
+                    {
+                        uploader->Queue(asset->textureID, level, GL_RGBA, mip.width, mip.height, GL_RGBA, 4, decoded);
+                        decoded += (size_t) mip.width * mip.height * 4;
+                        bytes += (size_t) mip.width * mip.height * 4;
+                    }
+                    else
+                    {
+                        uploader->Queue(asset->textureID, level, internalFormat, mip.width, mip.height, format, indexed ? 1 : 4, cooked.data + mip.offset);
+                        bytes += mip.size;
+                    }
+                }
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, cooked.header->mipCount - 1);
+                if (indexed)
+                {
+                    ApplyPalette(asset->textureID, cooked);
+                    glBindTexture(GL_TEXTURE_2D, asset->textureID);
+                    bytes += (size_t) COOKED_PALETTE_SIZE * cooked.header->paletteRows * 4;
+                }
+                if (record != NULL)
+                {
+                    record->bytes = bytes;
+                    record->levels = (int) cooked.header->mipCount;
+                }
+
+                // Filtering and wrapping were picked per asset at import time
+                bool linear = (cooked.header->flags & COOKED_FILTER_LINEAR) != 0;
+                bool mipmapped = cooked.header->mipCount > 1;
+                GLint wrap = (cooked.header->flags & COOKED_WRAP_CLAMP) ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linear ? (mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR)
+                                                                             : (mipmapped ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST));
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+
+                // Filtered texels between 0 and 255 would be cut off at the threshold
+                bool cutout = asset->coverage == ALPHA_BINARY && !linear && !mipmapped;
+                materials[asset->textureID] = asset->coverage == ALPHA_OPAQUE ? MATERIAL_OPAQUE : cutout ? MATERIAL_CUTOUT : MATERIAL_TRANSLUCENT;
+            }
+            else
+            {
+                uploader->Queue(asset->textureID, LEVEL_OF_DETAIL, GL_RGBA, asset->width, asset->height, GL_RGBA, 4, asset->pixels);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LEVEL_OF_DETAIL);
+
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+                materials[asset->textureID] = asset->coverage == ALPHA_OPAQUE ? MATERIAL_OPAQUE
+                                            : asset->coverage == ALPHA_BINARY ? MATERIAL_CUTOUT : MATERIAL_TRANSLUCENT;
+
+                if (record != NULL)
+                {
+                    record->bytes = (size_t) asset->width * asset->height * 4;
+                    record->levels = 1;
+                }
+            }
+            if (record != NULL) residentBytes += record->bytes;
+
+            streaming[asset->textureID] = asset;
+            return false;
+        }
+
+        case SOUND_ASSET:
+            if (asset->chunk == NULL) LOG("Unable to load sound " << asset->filepath << ".");
+            *asset->chunkDestination = asset->chunk;
+            break;
+
+        case MUSIC_ASSET:
+            if (asset->music == NULL)
+            {
+                LOG("Unable to load music " << asset->filepath << ".");
+                break;
+            }
+            *asset->musicDestination = asset->music;
+            if (asset->onMusicLoaded != NULL) asset->onMusicLoaded(asset->music);
+            break;
+    }
+
+    return true;
+}
+
+Material AssetLoader::TextureMaterial(GLuint textureID) const
+{
+    auto found = materials.find(textureID);
+    return found != materials.end() ? found->second : MATERIAL_TRANSLUCENT;
+}
+
+GLuint AssetLoader::TexturePalette(GLuint textureID, int *rows) const
+{
+    auto found = palettes.find(textureID);
+    if (found == palettes.end())
+    {
+        *rows = 0;
+        return 0;
+    }
+    *rows = found->second.rows;
+    return found->second.textureID;
+}
+
+bool AssetLoader::TextureUsed(GLuint textureID)
+{
+    auto found = textures.find(textureID);
+    if (found == textures.end()) return true;
+
+    TextureRecord &record = found->second;
+    record.lastUsed = frame;
+    if (record.residency == TEXTURE_EVICTED)
+    {
+        record.residency = TEXTURE_LOADING;
+        reloads++;
+        Decode(textureID, record.filepath);
+    }
+    return record.residency == TEXTURE_RESIDENT;
+}
+
+void AssetLoader::EndFrame()
+{
+    if (textureBudget > 0 && residentBytes > textureBudget)
+    {
+        // Oldest first, and never anything drawn this frame
+        std::vector<std::pair<int, GLuint>> candidates;
+        for (auto &entry : textures)
+        {
+            const TextureRecord &record = entry.second;
+            if (record.residency == TEXTURE_RESIDENT && record.bytes > 0 && record.lastUsed < frame) candidates.push_back({ record.lastUsed, entry.first });
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for (size_t i = 0; i < candidates.size() && residentBytes > textureBudget; i++)
+        {
+            Evict(candidates[i].second, textures[candidates[i].second]);
+        }
+    }
+    frame++;
+}
+
+void AssetLoader::Evict(GLuint textureID, TextureRecord &record)
+{
+    // GL_TEXTURE_MAX_LEVEL only stops levels being sampled; it takes
+    // respecifying them at 0x0 for the driver to let go of their storage
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    for (int level = LEVEL_OF_DETAIL + 1; level < record.levels; level++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    SetPlaceholder(textureID);
+    record.levels = 1;
+
+    auto palette = palettes.find(textureID);
+    if (palette != palettes.end())
+    {
+        glDeleteTextures(NUMBER_OF_TEXTURES, &palette->second.textureID);
+        palettes.erase(palette);
+    }
+    materials.erase(textureID);
+
+    residentBytes -= record.bytes;
+    record.bytes = 0;
+    record.residency = TEXTURE_EVICTED;
+    evictions++;
+}
+
+void AssetLoader::ApplyPalette(GLuint textureID, const MappedTexture &cooked)
+{
+    // One row of colours per variant, never filtered or wrapped into the next
+    Palette palette;
+    palette.rows = (int) cooked.header->paletteRows;
+    glGenTextures(NUMBER_OF_TEXTURES, &palette.textureID);
+    glBindTexture(GL_TEXTURE_2D, palette.textureID);
+    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, COOKED_PALETTE_SIZE, palette.rows, TEXTURE_BORDER,
+                 GL_RGBA, GL_UNSIGNED_BYTE, cooked.data + cooked.header->paletteOffset);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LEVEL_OF_DETAIL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    palettes[textureID] = palette;
+}
+
+void AssetLoader::ApplySoftware(LoadedAsset *asset)
+{
+    // Only the base level; the software renderer samples nearest
+    if (asset->cooked.data != NULL)
+    {
+        const MappedTexture &cooked = asset->cooked;
+        bool clamp = (cooked.header->flags & COOKED_WRAP_CLAMP) != 0;
+        if (cooked.header->format == COOKED_INDEX8)
+        {
+            softwareRenderer->SetPalettedTexture(asset->textureID, cooked.levels[0].width, cooked.levels[0].height, cooked.data + cooked.levels[0].offset,
+                                                 cooked.data + cooked.header->paletteOffset, cooked.header->paletteRows, clamp);
+        }
+        else
+        {
+            // Block-compressed levels have been decoded on the worker
+            const unsigned char *pixels = is_block_compressed(cooked.header->format) ? asset->decoded.data() : cooked.data + cooked.levels[0].offset;
+            softwareRenderer->SetTexture(asset->textureID, cooked.levels[0].width, cooked.levels[0].height, pixels, clamp);
+        }
+        unmap_cooked_texture(&asset->cooked);
+    }
+    else
+    {
+        softwareRenderer->SetTexture(asset->textureID, asset->width, asset->height, asset->pixels, false);
+        stbi_image_free(asset->pixels);
+    }
+}
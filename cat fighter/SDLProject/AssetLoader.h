@@ -0,0 +1,198 @@
+//
+//  AssetLoader.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef AssetLoader_h
+#define AssetLoader_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <SDL_mixer.h>
+#include <atomic>
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+#include "TextureUploader.h"
+#include "CookedTexture.h"
+#include "RenderQueue.h"
+
+class SoftwareRenderer;
+
+enum AssetType { TEXTURE_ASSET, SOUND_ASSET, MUSIC_ASSET };
+
+/**
+ * One finished load, decoded on a worker thread and waiting for the main
+ * thread to pick it up. Nodes are chained into the completion queue through
+ * `next`.
+ */
+struct LoadedAsset {
+    LoadedAsset *next = NULL;
+    AssetType type;
+    std::string filepath;
+
+    // Textures: either a mapped cooked file or CPU-side RGBA8 pixels decoded
+    // from the source image, plus the texture id handed out up front
+    GLuint textureID = 0;
+    MappedTexture cooked;
+    std::vector<unsigned char> decoded;   // cooked blocks GL can't take, as RGBA8, level after level
+    unsigned char *pixels = NULL;
+    int width = 0;
+    int height = 0;
+    AlphaCoverage coverage = ALPHA_BLENDED;
+
+    // Audio: where the result goes once it reaches the main thread
+    Mix_Chunk **chunkDestination = NULL;
+    Mix_Chunk *chunk = NULL;
+    Mix_Music **musicDestination = NULL;
+    Mix_Music *music = NULL;
+    void (*onMusicLoaded)(Mix_Music *music) = NULL;
+};
+
+/**
+ * Decodes images and audio on a pool of worker threads. Every request returns
+ * immediately: textures get their id straight away (bound to a transparent
+ * 1x1 placeholder) and audio pointers stay NULL until the asset arrives.
+ * LoadTexture() creates that id, so it too needs the GL context current.
+ *
+ * Textures come from the cooked .ctex next to the source image when there is
+ * one no older than the image (see tools/asset_cooker.cpp); otherwise the
+ * PNG/JPEG is decoded and premultiplied on the worker. Import settings are
+ * only known to the cooker, so changing them takes a run of it to show.
+ *
+ * Workers push finished assets onto lock-free completion queues, one for
+ * textures and one for audio. PumpTextures() must run on the thread that owns
+ * the GL context, once a frame; PumpAudio() runs on the simulation thread,
+ * which is the one that reads the sound and music pointers.
+ *
+ * Texels reach GL through a TextureUploader, at most the upload budget's
+ * worth per PumpTextures(), so a big image takes a few frames rather than
+ * one long one. A texture only counts as loaded, and is only reported by
+ * PumpTextures(), once all of it is in; until then TextureUsed() says not
+ * to draw it.
+ *
+ * Each texture's alpha is checked on the worker as well, and once it is
+ * uploaded TextureMaterial() says how it can be drawn: opaque if it has no
+ * transparency at all, cutout if it is sampled nearest from a single level
+ * and every texel is either fully transparent or fully opaque, translucent
+ * otherwise and until it has loaded.
+ *
+ * Indexed cooked textures are uploaded as one byte per texel (GL_R8 on a
+ * core context, GL_LUMINANCE on a legacy one) with their palette rows in a
+ * small texture of their own, which TexturePalette() hands to the renderer
+ * for the lookup in the fragment shader.
+ *
+ * Block-compressed cooked textures go to GL as they are when the driver
+ * has the extension for them, GL_EXT_texture_compression_s3tc for BC1 and
+ * BC3 and GL_ARB_texture_compression_bptc (core in 4.2) for BC7. Otherwise
+ * the worker decodes them to RGBA8 and they are uploaded like any other.
+ *
+ * Texture memory is kept within a budget. The renderer reports every
+ * texture it is about to draw through TextureUsed(), and EndFrame() shrinks the least
+ * recently used ones that were not drawn that frame back to the 1x1
+ * placeholder until the rest fit, respecifying every mip level so their
+ * storage really goes back to the driver. The id stays valid: drawing it again
+ * queues the same load as the first time, from the cooked file when there
+ * is one, and it samples as transparent until that has been uploaded. A
+ * budget of 0 never evicts anything. Destroying the loader deletes every
+ * texture, so that needs the GL context current as well.
+ *
+ * Given a SoftwareRenderer, textures go to it instead and no GL is touched:
+ * ids are simply counted up and PumpTextures() hands the pixels over.
+ */
+class AssetLoader {
+public:
+    AssetLoader(int threadCount, SoftwareRenderer *softwareRenderer = NULL, bool coreProfile = false);
+    ~AssetLoader();
+
+    GLuint LoadTexture(const char *filepath);
+    void LoadSound(const char *filepath, Mix_Chunk **destination);
+    void LoadMusic(const char *filepath, Mix_Music **destination, void (*onLoaded)(Mix_Music *music));
+
+    // Each returns how many finished assets it applied
+    int PumpTextures();
+    void SetUploadBudget(size_t bytesPerPump);
+    int PumpAudio();
+
+    int PendingCount() const { return pending.load(); }
+
+    // Only on the thread that calls PumpTextures()
+    Material TextureMaterial(GLuint textureID) const;
+
+    // The palette texture of an indexed texture and its number of rows, or 0
+    // for a texture that holds its colours directly. Same thread as above.
+    GLuint TexturePalette(GLuint textureID, int *rows) const;
+
+    // Residency, all on the thread that calls PumpTextures()
+    void SetTextureBudget(size_t bytes) { textureBudget = bytes; }
+    bool TextureUsed(GLuint textureID);   // false while it is not all there
+    void EndFrame();
+
+    size_t ResidentBytes() const { return residentBytes; }
+    int Evictions() const { return evictions; }
+    int Reloads() const { return reloads; }
+
+private:
+    enum Residency { TEXTURE_LOADING, TEXTURE_RESIDENT, TEXTURE_EVICTED };
+
+    struct TextureRecord {
+        std::string filepath;
+        Residency residency;
+        size_t bytes;
+        int levels;   // mip levels GL holds storage for
+        int lastUsed;
+    };
+
+    void Decode(GLuint textureID, const std::string &filepath);
+    void SetPlaceholder(GLuint textureID);
+    void Evict(GLuint textureID, TextureRecord &record);
+    void Complete(LoadedAsset *asset);
+    int Drain(std::atomic<LoadedAsset*> &completed);
+    bool Apply(LoadedAsset *asset);   // false when an upload still needs the asset
+    int FinishUploads();
+    void Release(std::atomic<LoadedAsset*> &completed);
+    void ApplySoftware(LoadedAsset *asset);
+    void ApplyPalette(GLuint textureID, const MappedTexture &cooked);
+    bool SamplesBlocks(uint32_t format) const;
+
+    struct Palette {
+        GLuint textureID;
+        int rows;
+    };
+
+    ThreadPool pool;
+    std::atomic<LoadedAsset*> completedTextures;
+    std::atomic<LoadedAsset*> completedAudio;
+    std::atomic<int> pending;
+
+    std::unordered_map<GLuint, Material> materials;
+    std::unordered_map<GLuint, Palette> palettes;
+    bool coreProfile;
+    bool s3tc = false;   // set before any work is queued, and only read after
+    bool bptc = false;
+
+    TextureUploader *uploader = NULL;
+    std::unordered_map<GLuint, LoadedAsset*> streaming;   // being uploaded
+    std::vector<GLuint> finishedUploads;
+
+    std::unordered_map<GLuint, TextureRecord> textures;
+    size_t textureBudget = 0;
+    size_t residentBytes = 0;
+    int frame = 0;
+    int evictions = 0;
+    int reloads = 0;
+
+    SoftwareRenderer *softwareRenderer;
+    GLuint softwareTextureCount = 0;
+};
+
+#endif /* AssetLoader_h */
@@ -0,0 +1,562 @@
+//
+//  BlockCompression.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+#include <string.h>
+#include "BlockCompression.h"
+
+const int BLOCK_TEXELS = 16;
+const int POWER_ITERATIONS = 8;   // rounds spent finding a block's principal axis
+const int REFINE_PASSES = 2;      // least-squares refits of the endpoints after the first guess
+
+// BC7 4-bit index weights, out of 64
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+const int BC7_MODE_6_BITS = 1 << 6;   // mode n is n zero bits followed by a one
+
+bool is_block_compressed(uint32_t format)
+{
+    return format == COOKED_BC1 || format == COOKED_BC3 || format == COOKED_BC7;
+}
+
+static size_t block_size(uint32_t format)
+{
+    return format == COOKED_BC1 ? 8 : 16;
+}
+
+/**
+ BLOCKS
+ */
+static void fetch_block(const unsigned char *pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, float texels[16][4])
+{
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+        uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+        const unsigned char *texel = pixels + ((size_t) y * width + x) * 4;
+        for (int channel = 0; channel < 4; channel++) texels[i][channel] = texel[channel];
+    }
+}
+
+static void store_block(const unsigned char texels[16][4], uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, unsigned char *pixels)
+{
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        uint32_t x = blockX * 4 + i % 4, y = blockY * 4 + i / 4;
+        if (x < width && y < height) memcpy(pixels + ((size_t) y * width + x) * 4, texels[i], 4);
+    }
+}
+
+static void put_bits(unsigned char *block, int *position, uint32_t value, int count)
+{
+    for (int bit = 0; bit < count; bit++, (*position)++)
+    {
+        if ((value >> bit) & 1) block[*position / 8] |= 1 << (*position % 8);
+    }
+}
+
+static uint32_t get_bits(const unsigned char *block, int *position, int count)
+{
+    uint32_t value = 0;
+    for (int bit = 0; bit < count; bit++, (*position)++)
+    {
+        value |= (uint32_t) ((block[*position / 8] >> (*position % 8)) & 1) << bit;
+    }
+    return value;
+}
+
+/**
+ ENDPOINTS
+ */
+/**
+ * The segment through a block's texels that they spread along the most,
+ * over the first `channels` channels: the principal axis of their
+ * covariance, found by power iteration from the diagonal of their bounding
+ * box, cut off at the furthest texels either side of their mean.
+ */
+static void fit_line(const float texels[16][4], int channels, float first[4], float second[4])
+{
+    float mean[4] = { 0, 0, 0, 0 }, low[4], high[4];
+    for (int channel = 0; channel < 4; channel++)
+    {
+        low[channel] = FLT_MAX;
+        high[channel] = -FLT_MAX;
+    }
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        for (int channel = 0; channel < channels; channel++)
+        {
+            mean[channel] += texels[i][channel] / BLOCK_TEXELS;
+            low[channel] = std::min(low[channel], texels[i][channel]);
+            high[channel] = std::max(high[channel], texels[i][channel]);
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        for (int row = 0; row < channels; row++)
+        {
+            for (int column = 0; column < channels; column++)
+            {
+                covariance[row][column] += (texels[i][row] - mean[row]) * (texels[i][column] - mean[column]);
+            }
+        }
+    }
+
+    float axis[4] = { 0, 0, 0, 0 };
+    for (int channel = 0; channel < channels; channel++) axis[channel] = high[channel] - low[channel];
+    for (int round = 0; round < POWER_ITERATIONS; round++)
+    {
+        float next[4] = { 0, 0, 0, 0 }, length = 0;
+        for (int row = 0; row < channels; row++)
+        {
+            for (int column = 0; column < channels; column++) next[row] += covariance[row][column] * axis[column];
+            length += next[row] * next[row];
+        }
+
+        // One colour all over: every texel sits on the mean
+        if (length < 1e-6f) break;
+
+        length = std::sqrt(length);
+        for (int channel = 0; channel < channels; channel++) axis[channel] = next[channel] / length;
+    }
+
+    float nearest = FLT_MAX, furthest = -FLT_MAX;
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        float projection = 0;
+        for (int channel = 0; channel < channels; channel++) projection += (texels[i][channel] - mean[channel]) * axis[channel];
+        nearest = std::min(nearest, projection);
+        furthest = std::max(furthest, projection);
+    }
+
+    for (int channel = 0; channel < 4; channel++)
+    {
+        first[channel] = channel < channels ? std::min(255.0f, std::max(0.0f, mean[channel] + axis[channel] * nearest)) : 0.0f;
+        second[channel] = channel < channels ? std::min(255.0f, std::max(0.0f, mean[channel] + axis[channel] * furthest)) : 0.0f;
+    }
+}
+
+/**
+ * The endpoints that reproduce the block best in the least-squares sense
+ * when each texel keeps its place along the line: weight 0 for the first
+ * endpoint, 1 for the second. False when every texel has the same weight,
+ * which leaves the endpoints undetermined.
+ */
+static bool fit_endpoints(const float texels[16][4], const float weights[16], int channels, float first[4], float second[4])
+{
+    float aa = 0, ab = 0, bb = 0;
+    float ax[4] = { 0, 0, 0, 0 }, bx[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        float a = 1.0f - weights[i], b = weights[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int channel = 0; channel < channels; channel++)
+        {
+            ax[channel] += a * texels[i][channel];
+            bx[channel] += b * texels[i][channel];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) return false;
+
+    for (int channel = 0; channel < channels; channel++)
+    {
+        first[channel] = std::min(255.0f, std::max(0.0f, (bb * ax[channel] - ab * bx[channel]) / determinant));
+        second[channel] = std::min(255.0f, std::max(0.0f, (aa * bx[channel] - ab * ax[channel]) / determinant));
+    }
+    return true;
+}
+
+// Nearest palette entry for every texel over the first `channels` channels; returns the total squared error
+static float pick_indices(const float texels[16][4], const int palette[][4], int entries, int channels, int indices[16])
+{
+    float total = 0;
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        float best = FLT_MAX;
+        for (int entry = 0; entry < entries; entry++)
+        {
+            float distance = 0;
+            for (int channel = 0; channel < channels; channel++)
+            {
+                float difference = texels[i][channel] - palette[entry][channel];
+                distance += difference * difference;
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = entry;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+/**
+ BC1 COLOUR
+ */
+static int quantize(float value, int maximum)
+{
+    return std::min(maximum, std::max(0, (int) std::lround(value * maximum / 255.0f)));
+}
+
+static uint16_t pack_565(const float color[4])
+{
+    return (uint16_t) ((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+}
+
+static void unpack_565(uint16_t packed, int color[4])
+{
+    int red = packed >> 11, green = (packed >> 5) & 63, blue = packed & 31;
+    color[0] = (red << 3) | (red >> 2);
+    color[1] = (green << 2) | (green >> 4);
+    color[2] = (blue << 3) | (blue >> 2);
+    color[3] = 255;
+}
+
+/**
+ * What a colour block's indices pick from. BC1 has a three-colour mode,
+ * with transparent black as the fourth, for when the first endpoint is not
+ * the larger; the colour half of a BC3 block always has four colours.
+ */
+static void color_palette(uint16_t first, uint16_t second, bool fourColors, int palette[4][4])
+{
+    unpack_565(first, palette[0]);
+    unpack_565(second, palette[1]);
+
+    if (first > second || fourColors)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+        palette[2][3] = palette[3][3] = 255;
+    }
+    else
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+            palette[3][channel] = 0;
+        }
+        palette[2][3] = 255;
+        palette[3][3] = 0;
+    }
+}
+
+static void encode_color_block(const float texels[16][4], unsigned char *block)
+{
+    // Where each index sits between the endpoints
+    const float WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float first[4], second[4];
+    fit_line(texels, 3, first, second);
+
+    uint16_t bestFirst = 0, bestSecond = 0;
+    int bestIndices[16] = {};
+    float bestError = FLT_MAX;
+    for (int pass = 0; pass <= REFINE_PASSES; pass++)
+    {
+        // Four-colour blocks need the larger endpoint first; which end is which doesn't matter
+        uint16_t a = pack_565(first), b = pack_565(second);
+        if (a < b) std::swap(a, b);
+
+        int palette[4][4], indices[16];
+        color_palette(a, b, true, palette);
+        float error = pick_indices(texels, palette, a == b ? 1 : 4, 3, indices);
+        if (error < bestError)
+        {
+            bestFirst = a;
+            bestSecond = b;
+            bestError = error;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (a == b) break;
+
+        float weights[16];
+        for (int i = 0; i < BLOCK_TEXELS; i++) weights[i] = WEIGHTS[indices[i]];
+        if (!fit_endpoints(texels, weights, 3, first, second)) break;
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < BLOCK_TEXELS; i++) bits |= (uint32_t) bestIndices[i] << (i * 2);
+
+    block[0] = bestFirst & 0xFF;
+    block[1] = bestFirst >> 8;
+    block[2] = bestSecond & 0xFF;
+    block[3] = bestSecond >> 8;
+    for (int i = 0; i < 4; i++) block[4 + i] = (bits >> (i * 8)) & 0xFF;
+}
+
+static void decode_color_block(const unsigned char *block, bool fourColors, unsigned char texels[16][4])
+{
+    uint16_t first = block[0] | (block[1] << 8), second = block[2] | (block[3] << 8);
+    uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t) block[7] << 24);
+
+    int palette[4][4];
+    color_palette(first, second, fourColors, palette);
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        const int *color = palette[(bits >> (i * 2)) & 3];
+        for (int channel = 0; channel < 4; channel++) texels[i][channel] = (unsigned char) color[channel];
+    }
+}
+
+/**
+ BC3 ALPHA
+ */
+/**
+ * The eight alphas an alpha block's indices pick from: an even ramp between
+ * the endpoints when the first is larger, otherwise a shorter ramp plus
+ * fully transparent and fully opaque, for blocks that mix hard and soft edges.
+ */
+static void alpha_ramp(int first, int second, int ramp[8][4])
+{
+    ramp[0][0] = first;
+    ramp[1][0] = second;
+    if (first > second)
+    {
+        for (int step = 1; step < 7; step++) ramp[step + 1][0] = ((7 - step) * first + step * second) / 7;
+    }
+    else
+    {
+        for (int step = 1; step < 5; step++) ramp[step + 1][0] = ((5 - step) * first + step * second) / 5;
+        ramp[6][0] = 0;
+        ramp[7][0] = 255;
+    }
+}
+
+static void encode_alpha_block(const float texels[16][4], unsigned char *block)
+{
+    // pick_indices() wants the channel first
+    float alphas[16][4];
+    int low = 255, high = 0, softLow = 255, softHigh = 0;
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        int alpha = (int) std::lround(texels[i][3]);
+        alphas[i][0] = (float) alpha;
+        low = std::min(low, alpha);
+        high = std::max(high, alpha);
+        if (alpha != 0 && alpha != 255)
+        {
+            softLow = std::min(softLow, alpha);
+            softHigh = std::max(softHigh, alpha);
+        }
+    }
+    if (softLow > softHigh) softLow = softHigh = low;
+
+    // The full ramp over the whole range, against the short one over just the soft texels
+    int candidates[2][2] = { { high, low }, { softLow, softHigh } };
+    int bestIndices[16] = {}, best = 0;
+    float bestError = FLT_MAX;
+    for (int candidate = 0; candidate < 2; candidate++)
+    {
+        int ramp[8][4], indices[16];
+        alpha_ramp(candidates[candidate][0], candidates[candidate][1], ramp);
+        float error = pick_indices(alphas, ramp, 8, 1, indices);
+        if (error < bestError)
+        {
+            best = candidate;
+            bestError = error;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+    }
+
+    block[0] = (unsigned char) candidates[best][0];
+    block[1] = (unsigned char) candidates[best][1];
+    int position = 16;
+    for (int i = 0; i < BLOCK_TEXELS; i++) put_bits(block, &position, bestIndices[i], 3);
+}
+
+static void decode_alpha_block(const unsigned char *block, unsigned char texels[16][4])
+{
+    int ramp[8][4];
+    alpha_ramp(block[0], block[1], ramp);
+
+    int position = 16;
+    for (int i = 0; i < BLOCK_TEXELS; i++) texels[i][3] = (unsigned char) ramp[get_bits(block, &position, 3)][0];
+}
+
+/**
+ BC7 MODE 6
+ */
+// The nearest endpoint mode 6 can hold: seven bits per channel, plus one low bit shared by all four
+static void quantize_bc7_endpoint(const float value[4], int quantized[4], int *lowBit)
+{
+    float bestError = FLT_MAX;
+    for (int bit = 0; bit < 2; bit++)
+    {
+        int candidate[4];
+        float error = 0;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            candidate[channel] = std::min(127, std::max(0, (int) std::lround((value[channel] - bit) / 2.0f)));
+            float difference = value[channel] - (candidate[channel] * 2 + bit);
+            error += difference * difference;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            memcpy(quantized, candidate, sizeof(candidate));
+            *lowBit = bit;
+        }
+    }
+}
+
+static void bc7_palette(const int first[4], int firstBit, const int second[4], int secondBit, int palette[16][4])
+{
+    for (int index = 0; index < 16; index++)
+    {
+        for (int channel = 0; channel < 4; channel++)
+        {
+            int from = first[channel] * 2 + firstBit, to = second[channel] * 2 + secondBit;
+            palette[index][channel] = ((64 - BC7_WEIGHTS[index]) * from + BC7_WEIGHTS[index] * to + 32) >> 6;
+        }
+    }
+}
+
+static void encode_bc7_block(const float texels[16][4], unsigned char *block)
+{
+    float first[4], second[4];
+    fit_line(texels, 4, first, second);
+
+    int bestFirst[4] = {}, bestSecond[4] = {}, bestBits[2] = {}, bestIndices[16] = {};
+    float bestError = FLT_MAX;
+    for (int pass = 0; pass <= REFINE_PASSES; pass++)
+    {
+        int a[4], b[4], aBit, bBit, palette[16][4], indices[16];
+        quantize_bc7_endpoint(first, a, &aBit);
+        quantize_bc7_endpoint(second, b, &bBit);
+        bc7_palette(a, aBit, b, bBit, palette);
+
+        float error = pick_indices(texels, palette, 16, 4, indices);
+        if (error < bestError)
+        {
+            memcpy(bestFirst, a, sizeof(a));
+            memcpy(bestSecond, b, sizeof(b));
+            bestBits[0] = aBit;
+            bestBits[1] = bBit;
+            memcpy(bestIndices, indices, sizeof(indices));
+            bestError = error;
+        }
+
+        float weights[16];
+        for (int i = 0; i < BLOCK_TEXELS; i++) weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+        if (!fit_endpoints(texels, weights, 4, first, second)) break;
+    }
+
+    // The first texel's index loses its top bit, so it has to be in the lower half
+    if (bestIndices[0] >= 8)
+    {
+        for (int channel = 0; channel < 4; channel++) std::swap(bestFirst[channel], bestSecond[channel]);
+        std::swap(bestBits[0], bestBits[1]);
+        for (int i = 0; i < BLOCK_TEXELS; i++) bestIndices[i] = 15 - bestIndices[i];
+    }
+
+    memset(block, 0, 16);
+    int position = 0;
+    put_bits(block, &position, BC7_MODE_6_BITS, 7);
+    for (int channel = 0; channel < 4; channel++)
+    {
+        put_bits(block, &position, bestFirst[channel], 7);
+        put_bits(block, &position, bestSecond[channel], 7);
+    }
+    put_bits(block, &position, bestBits[0], 1);
+    put_bits(block, &position, bestBits[1], 1);
+    for (int i = 0; i < BLOCK_TEXELS; i++) put_bits(block, &position, bestIndices[i], i == 0 ? 3 : 4);
+}
+
+static void decode_bc7_block(const unsigned char *block, unsigned char texels[16][4])
+{
+    if ((block[0] & 0x7F) != BC7_MODE_6_BITS)
+    {
+        memset(texels, 0, BLOCK_TEXELS * 4);
+        return;
+    }
+
+    int position = 7, first[4], second[4], palette[16][4];
+    for (int channel = 0; channel < 4; channel++)
+    {
+        first[channel] = get_bits(block, &position, 7);
+        second[channel] = get_bits(block, &position, 7);
+    }
+    int firstBit = get_bits(block, &position, 1);
+    int secondBit = get_bits(block, &position, 1);
+    bc7_palette(first, firstBit, second, secondBit, palette);
+
+    for (int i = 0; i < BLOCK_TEXELS; i++)
+    {
+        const int *color = palette[get_bits(block, &position, i == 0 ? 3 : 4)];
+        for (int channel = 0; channel < 4; channel++) texels[i][channel] = (unsigned char) color[channel];
+    }
+}
+
+/**
+ LEVELS
+ */
+void encode_blocks(uint32_t format, const unsigned char *pixels, uint32_t width, uint32_t height, std::vector<unsigned char> &blocks)
+{
+    blocks.assign(cooked_level_size(format, width, height), 0);
+
+    unsigned char *block = blocks.data();
+    for (uint32_t blockY = 0; blockY < (height + 3) / 4; blockY++)
+    {
+        for (uint32_t blockX = 0; blockX < (width + 3) / 4; blockX++, block += block_size(format))
+        {
+            float texels[16][4];
+            fetch_block(pixels, width, height, blockX, blockY, texels);
+
+            switch (format)
+            {
+                case COOKED_BC1:
+                    encode_color_block(texels, block);
+                    break;
+                case COOKED_BC3:
+                    encode_alpha_block(texels, block);
+                    encode_color_block(texels, block + 8);
+                    break;
+                case COOKED_BC7:
+                    encode_bc7_block(texels, block);
+                    break;
+            }
+        }
+    }
+}
+
+void decode_blocks(uint32_t format, const unsigned char *blocks, uint32_t width, uint32_t height, unsigned char *pixels)
+{
+    const unsigned char *block = blocks;
+    for (uint32_t blockY = 0; blockY < (height + 3) / 4; blockY++)
+    {
+        for (uint32_t blockX = 0; blockX < (width + 3) / 4; blockX++, block += block_size(format))
+        {
+            unsigned char texels[16][4];
+            switch (format)
+            {
+                case COOKED_BC1:
+                    decode_color_block(block, false, texels);
+                    break;
+                case COOKED_BC3:
+                    decode_color_block(block + 8, true, texels);
+                    decode_alpha_block(block, texels);
+                    break;
+                case COOKED_BC7:
+                    decode_bc7_block(block, texels);
+                    break;
+            }
+            store_block(texels, width, height, blockX, blockY, pixels);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+//
+//  BlockCompression.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef BlockCompression_h
+#define BlockCompression_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "CookedTexture.h"
+
+/**
+ * The CPU side of the block-compressed cooked formats. The asset cooker
+ * encodes with it offline; at runtime it decodes back to RGBA8 for drivers
+ * that can't sample a format themselves, and for the software renderer.
+ *
+ * Every format stores 4x4 texels per block, so a level takes an eighth
+ * (BC1) or a quarter (BC3, BC7) of the memory it would as RGBA8:
+ *
+ *     COOKED_BC1   8 bytes: two RGB565 endpoints, 2-bit indices
+ *     COOKED_BC3  16 bytes: an 8-step alpha ramp, then a BC1 colour block
+ *     COOKED_BC7  16 bytes: mode 6, one RGBA line with 7-bit endpoints
+ *                           plus a shared low bit each, 4-bit indices
+ *
+ * Texels are premultiplied going in and coming out, like everything else
+ * that is cooked. The BC1 encoder only writes four-colour blocks, which
+ * are always opaque, so anything with transparency wants BC3 or BC7.
+ * The BC7 encoder only uses mode 6 and the decoder only reads it; a block
+ * in any other mode decodes as transparent black.
+ *
+ * Edges that don't fill a whole block are encoded by repeating the last
+ * row and column, and only the texels inside the level are decoded.
+ * Decoding rounds the interpolated colours the way the specifications
+ * write them; GPUs are allowed to, and do, come out a step away.
+ */
+bool is_block_compressed(uint32_t format);
+
+// Replaces `blocks` with the encoded level, cooked_level_size() bytes long
+void encode_blocks(uint32_t format, const unsigned char *pixels, uint32_t width, uint32_t height, std::vector<unsigned char> &blocks);
+
+// Writes width * height RGBA8 texels
+void decode_blocks(uint32_t format, const unsigned char *blocks, uint32_t width, uint32_t height, unsigned char *pixels);
+
+#endif /* BlockCompression_h */
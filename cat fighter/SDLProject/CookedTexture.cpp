@@ -0,0 +1,255 @@
+//
+//  CookedTexture.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include "CookedTexture.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WINDOWS
+#include <stdlib.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+std::string cooked_texture_path(const std::string &filepath)
+{
+    // assets/stone.png -> assets/cooked/stone.ctex
+    size_t slash = filepath.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "" : filepath.substr(0, slash + 1);
+    std::string name = slash == std::string::npos ? filepath : filepath.substr(slash + 1);
+
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos) name = name.substr(0, dot);
+
+    return directory + COOKED_TEXTURE_DIRECTORY + name + COOKED_TEXTURE_EXTENSION;
+}
+
+bool cooked_texture_is_current(const std::string &source, const std::string &cooked)
+{
+    struct stat source_info, cooked_info;
+    if (stat(cooked.c_str(), &cooked_info) != 0) return false;
+    if (stat(source.c_str(), &source_info) != 0) return true;
+    return source_info.st_mtime <= cooked_info.st_mtime;
+}
+
+size_t cooked_level_size(uint32_t format, uint32_t width, uint32_t height)
+{
+    size_t blocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+    switch (format)
+    {
+        case COOKED_RGBA8:  return (size_t) width * height * 4;
+        case COOKED_INDEX8: return (size_t) width * height;
+        case COOKED_BC1:    return blocks * 8;
+        case COOKED_BC3:
+        case COOKED_BC7:    return blocks * 16;
+    }
+    return 0;
+}
+
+static bool validate_cooked_texture(MappedTexture *texture)
+{
+    if (texture->length < sizeof(CookedTextureHeader)) return false;
+
+    const CookedTextureHeader *header = (const CookedTextureHeader *) texture->data;
+    if (memcmp(header->magic, COOKED_TEXTURE_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (header->version != COOKED_TEXTURE_VERSION) return false;
+    if (header->mipCount == 0) return false;
+
+    size_t tableEnd = sizeof(CookedTextureHeader) + header->mipCount * sizeof(CookedMipLevel);
+    if (texture->length < tableEnd) return false;
+
+    const CookedMipLevel *levels = (const CookedMipLevel *) (texture->data + sizeof(CookedTextureHeader));
+    for (uint32_t i = 0; i < header->mipCount; i++)
+    {
+        if ((size_t) levels[i].offset + levels[i].size > texture->length) return false;
+
+        // Also catches a format this build doesn't know
+        size_t expected = cooked_level_size(header->format, levels[i].width, levels[i].height);
+        if (expected == 0 || levels[i].size != expected) return false;
+    }
+
+    if (header->format == COOKED_INDEX8)
+    {
+        size_t paletteBytes = (size_t) header->paletteRows * COOKED_PALETTE_SIZE * 4;
+        if (header->paletteRows == 0 || (size_t) header->paletteOffset + paletteBytes > texture->length) return false;
+    }
+
+    texture->header = header;
+    texture->levels = levels;
+    return true;
+}
+
+bool map_cooked_texture(const std::string &filepath, MappedTexture *texture)
+{
+    *texture = MappedTexture();
+
+#ifdef _WINDOWS
+    // No mmap here; read the whole file instead
+    FILE *file = fopen(filepath.c_str(), "rb");
+    if (file == NULL) return false;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *data = (unsigned char *) malloc(length);
+    if (data == NULL || fread(data, 1, length, file) != (size_t) length)
+    {
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    texture->data = data;
+    texture->length = length;
+#else
+    int descriptor = open(filepath.c_str(), O_RDONLY);
+    if (descriptor < 0) return false;
+
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+    {
+        close(descriptor);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED) return false;
+
+    texture->data = (const unsigned char *) mapping;
+    texture->length = info.st_size;
+#endif
+
+    if (!validate_cooked_texture(texture))
+    {
+        unmap_cooked_texture(texture);
+        return false;
+    }
+
+    return true;
+}
+
+void unmap_cooked_texture(MappedTexture *texture)
+{
+    if (texture->data == NULL) return;
+
+#ifdef _WINDOWS
+    free((void *) texture->data);
+#else
+    munmap((void *) texture->data, texture->length);
+#endif
+
+    *texture = MappedTexture();
+}
+
+void premultiply_rgba8(unsigned char *pixels, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount * 4; i += 4)
+    {
+        unsigned alpha = pixels[i + 3];
+        pixels[i + 0] = (unsigned char) ((pixels[i + 0] * alpha + 127) / 255);
+        pixels[i + 1] = (unsigned char) ((pixels[i + 1] * alpha + 127) / 255);
+        pixels[i + 2] = (unsigned char) ((pixels[i + 2] * alpha + 127) / 255);
+    }
+}
+
+AlphaCoverage classify_alpha_rgba8(const unsigned char *pixels, size_t pixelCount)
+{
+    AlphaCoverage coverage = ALPHA_OPAQUE;
+    for (size_t i = 3; i < pixelCount * 4; i += 4)
+    {
+        if (pixels[i] == 255) continue;
+        if (pixels[i] != 0) return ALPHA_BLENDED;
+        coverage = ALPHA_BINARY;
+    }
+    return coverage;
+}
+
+AlphaCoverage classify_alpha_index8(const unsigned char *indices, size_t pixelCount, const unsigned char *palette, uint32_t paletteRows)
+{
+    bool used[COOKED_PALETTE_SIZE] = { false };
+    for (size_t i = 0; i < pixelCount; i++) used[indices[i]] = true;
+
+    AlphaCoverage coverage = ALPHA_OPAQUE;
+    for (uint32_t row = 0; row < paletteRows; row++)
+    {
+        for (uint32_t entry = 0; entry < COOKED_PALETTE_SIZE; entry++)
+        {
+            if (!used[entry]) continue;
+
+            unsigned char alpha = palette[(row * COOKED_PALETTE_SIZE + entry) * 4 + 3];
+            if (alpha == 255) continue;
+            if (alpha != 0) return ALPHA_BLENDED;
+            coverage = ALPHA_BINARY;
+        }
+    }
+    return coverage;
+}
+
+bool write_cooked_texture(const std::string &filepath, uint32_t format, uint32_t flags, uint32_t importHash, const std::vector<CookedLevelData> &levels,
+                          const std::vector<unsigned char> &palette)
+{
+    if (levels.empty()) return false;
+
+    CookedTextureHeader header;
+    memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic));
+    header.version  = COOKED_TEXTURE_VERSION;
+    header.width    = levels[0].width;
+    header.height   = levels[0].height;
+    header.format   = format;
+    header.flags    = flags;
+    header.mipCount = (uint32_t) levels.size();
+    header.importHash = importHash;
+    header.paletteRows = format == COOKED_INDEX8 ? (uint32_t) (palette.size() / (COOKED_PALETTE_SIZE * 4)) : 0;
+    header.paletteOffset = 0;
+
+    // Lay the levels out after the table, each starting on a 16-byte boundary
+    std::vector<CookedMipLevel> table(levels.size());
+    uint32_t offset = sizeof(CookedTextureHeader) + (uint32_t) (levels.size() * sizeof(CookedMipLevel));
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        offset = (offset + 15) & ~15u;
+        table[i].width  = levels[i].width;
+        table[i].height = levels[i].height;
+        table[i].offset = offset;
+        table[i].size   = (uint32_t) levels[i].pixels.size();
+        offset += table[i].size;
+    }
+    if (header.paletteRows > 0) header.paletteOffset = (offset + 15) & ~15u;
+
+    FILE *file = fopen(filepath.c_str(), "wb");
+    if (file == NULL) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(table.data(), sizeof(CookedMipLevel), table.size(), file) == table.size();
+
+    for (size_t i = 0; ok && i < levels.size(); i++)
+    {
+        static const unsigned char padding[16] = { 0 };
+        long position = ftell(file);
+        ok = fwrite(padding, 1, table[i].offset - position, file) == (size_t) (table[i].offset - position);
+        ok = ok && fwrite(levels[i].pixels.data(), 1, levels[i].pixels.size(), file) == levels[i].pixels.size();
+    }
+
+    if (ok && header.paletteRows > 0)
+    {
+        static const unsigned char padding[16] = { 0 };
+        long position = ftell(file);
+        size_t paletteBytes = (size_t) header.paletteRows * COOKED_PALETTE_SIZE * 4;
+        ok = fwrite(padding, 1, header.paletteOffset - position, file) == (size_t) (header.paletteOffset - position);
+        ok = ok && fwrite(palette.data(), 1, paletteBytes, file) == paletteBytes;
+    }
+
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,132 @@
+//
+//  CookedTexture.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef CookedTexture_h
+#define CookedTexture_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * On-disk layout of a cooked texture (.ctex), written offline by
+ * tools/asset_cooker and mapped straight into memory at runtime:
+ *
+ *     CookedTextureHeader
+ *     CookedMipLevel[mipCount]
+ *     pixel data for each level, 16-byte aligned, largest level first
+ *     palette (COOKED_INDEX8 only), 16-byte aligned
+ *
+ * COOKED_INDEX8 textures hold one palette index per texel and a palette of
+ * paletteRows rows of COOKED_PALETTE_SIZE premultiplied RGBA8 colours. Row 0
+ * is the source image's colours; any further rows are recolourings of it,
+ * picked per sprite when it is drawn.
+ *
+ * COOKED_BC1, COOKED_BC3 and COOKED_BC7 levels are 4x4 blocks in the
+ * S3TC/BPTC layouts GL takes as they are (see BlockCompression.h), row of
+ * blocks after row of blocks, with partial blocks at the right and bottom
+ * edges; a level smaller than 4x4 is still one whole block.
+ *
+ * All fields are little-endian. Bump COOKED_TEXTURE_VERSION whenever the
+ * layout changes; stale files are ignored and the source image is decoded.
+ */
+const char     COOKED_TEXTURE_MAGIC[4]  = { 'C', 'T', 'E', 'X' };
+const uint32_t COOKED_TEXTURE_VERSION   = 4;
+const char     COOKED_TEXTURE_DIRECTORY[] = "cooked/";
+const char     COOKED_TEXTURE_EXTENSION[] = ".ctex";
+const uint32_t COOKED_PALETTE_SIZE      = 256;   // colours per palette row
+
+enum CookedPixelFormat { COOKED_RGBA8 = 0, COOKED_INDEX8 = 1, COOKED_BC1 = 2, COOKED_BC3 = 3, COOKED_BC7 = 4 };
+
+enum CookedTextureFlags {
+    COOKED_PREMULTIPLIED = 1 << 0,
+    COOKED_FILTER_LINEAR = 1 << 1,   // linear (and trilinear with mips) instead of nearest
+    COOKED_WRAP_CLAMP    = 1 << 2    // clamp to edge instead of repeat
+};
+
+struct CookedTextureHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t flags;
+    uint32_t mipCount;
+    uint32_t importHash;   // of the import settings the file was cooked with
+    uint32_t paletteRows;      // 0 unless COOKED_INDEX8
+    uint32_t paletteOffset;    // from the start of the file
+};
+
+struct CookedMipLevel {
+    uint32_t width;
+    uint32_t height;
+    uint32_t offset;   // from the start of the file
+    uint32_t size;     // in bytes
+};
+
+/**
+ * A read-only view of a cooked texture. `data` points at the start of the
+ * file (the mapping itself on POSIX), so level pixels are just
+ * `data + levels[i].offset`.
+ */
+struct MappedTexture {
+    const unsigned char *data = NULL;
+    size_t length = 0;
+    const CookedTextureHeader *header = NULL;
+    const CookedMipLevel *levels = NULL;
+};
+
+std::string cooked_texture_path(const std::string &filepath);
+
+// False when the source image has been saved since the cooked file was
+// written. A missing source, as in a build that ships only cooked files,
+// counts as unchanged.
+bool cooked_texture_is_current(const std::string &source, const std::string &cooked);
+
+// Bytes one level of the given size takes in the given format, 0 for an unknown format
+size_t cooked_level_size(uint32_t format, uint32_t width, uint32_t height);
+
+bool map_cooked_texture(const std::string &filepath, MappedTexture *texture);
+void unmap_cooked_texture(MappedTexture *texture);
+
+/**
+ * One level of a texture as the cooker builds it in memory.
+ */
+struct CookedLevelData {
+    uint32_t width;
+    uint32_t height;
+    std::vector<unsigned char> pixels;
+};
+
+/**
+ * Scales colour by alpha in place. Cooked textures are stored this way, and
+ * images decoded at runtime go through the same conversion so both paths
+ * blend identically.
+ */
+void premultiply_rgba8(unsigned char *pixels, size_t pixelCount);
+
+/**
+ * What a texture's alpha channel holds: 255 everywhere, nothing but 0 and
+ * 255, or anything in between. Decides whether it can be drawn without
+ * blending (see Material in RenderQueue.h).
+ */
+enum AlphaCoverage { ALPHA_OPAQUE, ALPHA_BINARY, ALPHA_BLENDED };
+
+AlphaCoverage classify_alpha_rgba8(const unsigned char *pixels, size_t pixelCount);
+
+// The same for an indexed texture, over the colours its texels use in every palette row
+AlphaCoverage classify_alpha_index8(const unsigned char *indices, size_t pixelCount, const unsigned char *palette, uint32_t paletteRows);
+
+/**
+ * `palette` is only written for COOKED_INDEX8: paletteRows rows of
+ * COOKED_PALETTE_SIZE RGBA8 colours, one after the other.
+ */
+bool write_cooked_texture(const std::string &filepath, uint32_t format, uint32_t flags, uint32_t importHash, const std::vector<CookedLevelData> &levels,
+                          const std::vector<unsigned char> &palette = std::vector<unsigned char>());
+
+#endif /* CookedTexture_h */
@@ -0,0 +1,57 @@
+//
+//  Culling.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <algorithm>
+#include <cmath>
+#include "glm/mat4x4.hpp"
+#include "glm/gtc/matrix_inverse.hpp"
+#include "ShaderProgram.h"
+#include "Entity.h"
+#include "Culling.h"
+
+const float SPRITE_HALF_EXTENT = 0.5f;
+
+Bounds2D view_bounds(const glm::mat4 &projection, const glm::mat4 &view)
+{
+    // Push the four NDC corners back through (projection * view)^-1
+    glm::mat4 inverse = glm::inverse(projection * view);
+    Bounds2D bounds = { INFINITY, -INFINITY, INFINITY, -INFINITY };
+
+    const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+    for (int i = 0; i < 4; i++)
+    {
+        glm::vec4 world = inverse * glm::vec4(corners[i][0], corners[i][1], 0.0f, 1.0f);
+        world /= world.w;
+
+        bounds.left   = std::min(bounds.left,   world.x);
+        bounds.right  = std::max(bounds.right,  world.x);
+        bounds.bottom = std::min(bounds.bottom, world.y);
+        bounds.top    = std::max(bounds.top,    world.y);
+    }
+
+    return bounds;
+}
+
+Bounds2D entity_bounds(const Entity &entity)
+{
+    return { entity.position.x - SPRITE_HALF_EXTENT, entity.position.x + SPRITE_HALF_EXTENT,
+             entity.position.y - SPRITE_HALF_EXTENT, entity.position.y + SPRITE_HALF_EXTENT };
+}
+
+bool is_visible(const Entity &entity, const Bounds2D &view)
+{
+    return overlaps(entity_bounds(entity), view);
+}
@@ -0,0 +1,48 @@
+//
+//  Culling.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef Culling_h
+#define Culling_h
+
+#include "glm/mat4x4.hpp"
+
+class Entity;
+
+/**
+ * An axis-aligned rectangle in world units.
+ */
+struct Bounds2D {
+    float left, right, bottom, top;
+};
+
+inline bool overlaps(const Bounds2D &a, const Bounds2D &b)
+{
+    return a.left < b.right && b.left < a.right && a.bottom < b.top && b.bottom < a.top;
+}
+
+/**
+ * What the camera sees, recovered from the same matrices the shader gets.
+ */
+Bounds2D view_bounds(const glm::mat4 &projection, const glm::mat4 &view);
+
+/**
+ * The quad Entity::render draws, which is one unit square around the
+ * entity's position no matter what its collision width/height are.
+ */
+Bounds2D entity_bounds(const Entity &entity);
+
+bool is_visible(const Entity &entity, const Bounds2D &view);
+
+/**
+ * Per-frame culling totals, over active entities only.
+ */
+struct CullStats {
+    int drawn = 0;
+    int culled = 0;
+};
+
+#endif /* Culling_h */
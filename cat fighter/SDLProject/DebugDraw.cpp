@@ -0,0 +1,123 @@
+//
+//  DebugDraw.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifdef DEBUG
+
+#define GL_SILENCE_DEPRECATION
+
+#include "glm/geometric.hpp"
+#include "DebugDraw.h"
+#include "RenderDevice.h"
+#include "ShaderProgram.h"
+
+const float LINE_WIDTH = 0.03f;   // world units, about two pixels at the game's zoom
+
+const GLsizei STRIDE = DebugDrawList::FLOATS_PER_VERTEX * sizeof(float);
+
+void DebugDrawList::Quad(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d, const glm::vec4 &color)
+{
+    const glm::vec2 corners[] = { a, b, c, a, c, d };
+    for (const glm::vec2 &corner : corners)
+    {
+        const float vertex[] = { corner.x, corner.y, color.r * color.a, color.g * color.a, color.b * color.a, color.a };
+        vertices.insert(vertices.end(), vertex, vertex + FLOATS_PER_VERTEX);
+    }
+}
+
+void DebugDrawList::Line(glm::vec2 from, glm::vec2 to, const glm::vec4 &color)
+{
+    glm::vec2 along = to - from;
+    float length = glm::length(along);
+    if (length == 0) return;
+
+    glm::vec2 side = glm::vec2(-along.y, along.x) * (LINE_WIDTH * 0.5f / length);
+    Quad(from - side, to - side, to + side, from + side, color);
+}
+
+void DebugDrawList::Box(const Bounds2D &bounds, const glm::vec4 &color)
+{
+    // Each edge inset by half a line, so the outline stays inside the box
+    float half = LINE_WIDTH * 0.5f;
+    float left = bounds.left + half, right = bounds.right - half;
+    float bottom = bounds.bottom + half, top = bounds.top - half;
+
+    Line(glm::vec2(bounds.left, bottom), glm::vec2(bounds.right, bottom), color);
+    Line(glm::vec2(bounds.left, top), glm::vec2(bounds.right, top), color);
+    Line(glm::vec2(left, bottom + half), glm::vec2(left, top - half), color);
+    Line(glm::vec2(right, bottom + half), glm::vec2(right, top - half), color);
+}
+
+void DebugDrawList::FilledBox(const Bounds2D &bounds, const glm::vec4 &color)
+{
+    Quad(glm::vec2(bounds.left, bounds.bottom), glm::vec2(bounds.right, bounds.bottom),
+         glm::vec2(bounds.right, bounds.top), glm::vec2(bounds.left, bounds.top), color);
+}
+
+DebugDraw::DebugDraw(bool coreProfile) : coreProfile(coreProfile)
+{
+    glGenBuffers(1, &buffer);
+    if (!coreProfile) return;
+
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    PointAttributes(POSITION_LOCATION, COLOR_LOCATION);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+DebugDraw::~DebugDraw()
+{
+    glDeleteBuffers(1, &buffer);
+    if (vertexArray != 0) glDeleteVertexArrays(1, &vertexArray);
+}
+
+void DebugDraw::PointAttributes(GLuint position, GLuint color)
+{
+    glVertexAttribPointer(position, 2, GL_FLOAT, false, STRIDE, NULL);
+    glVertexAttribPointer(color, 4, GL_FLOAT, false, STRIDE, (const float *) NULL + 2);
+    glEnableVertexAttribArray(position);
+    glEnableVertexAttribArray(color);
+}
+
+void DebugDraw::Draw(const DebugDrawList &list, RenderDevice &device, ShaderProgram *program,
+                     const glm::mat4 &projection, const glm::mat4 &view)
+{
+    if (list.VertexCount() == 0) return;
+
+    // Orphaned and refilled every frame; it is never more than a few KB
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, list.Vertices().size() * sizeof(float), list.Vertices().data(), GL_STREAM_DRAW);
+
+    device.SetCamera(program, projection, view);
+    program->SetModelMatrix(glm::mat4(1.0f));
+
+    GLuint colorAttribute = glGetAttribLocation(program->programID, "vertexColor");
+    if (coreProfile)
+    {
+        glBindVertexArray(vertexArray);
+    }
+    else
+    {
+        PointAttributes(program->positionAttribute, colorAttribute);
+    }
+
+    glDrawArrays(GL_TRIANGLES, 0, list.VertexCount());
+
+    if (coreProfile)
+    {
+        glBindVertexArray(0);
+    }
+    else
+    {
+        glDisableVertexAttribArray(program->positionAttribute);
+        glDisableVertexAttribArray(colorAttribute);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif /* DEBUG */
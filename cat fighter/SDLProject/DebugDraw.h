@@ -0,0 +1,83 @@
+//
+//  DebugDraw.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef DebugDraw_h
+#define DebugDraw_h
+
+#ifdef DEBUG
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "Culling.h"
+
+class RenderDevice;
+class ShaderProgram;
+
+/**
+ * Shapes for seeing what collision sees: boxes, grid cells, contact
+ * normals. Recorded on the simulation thread into the frame's snapshot,
+ * as one triangle list with a colour per vertex (x, y, r, g, b, a, colours
+ * premultiplied). Lines become quads LINE_WIDTH world units wide, so
+ * everything fits in that one list.
+ */
+class DebugDrawList {
+public:
+    static const int FLOATS_PER_VERTEX = 6;
+
+    void Clear() { vertices.clear(); }
+
+    void Line(glm::vec2 from, glm::vec2 to, const glm::vec4 &color);
+    void Box(const Bounds2D &bounds, const glm::vec4 &color);
+    void FilledBox(const Bounds2D &bounds, const glm::vec4 &color);
+
+    const std::vector<float> &Vertices() const { return vertices; }
+    int VertexCount() const { return (int) vertices.size() / FLOATS_PER_VERTEX; }
+
+private:
+    void Quad(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d, const glm::vec4 &color);
+
+    std::vector<float> vertices;
+};
+
+/**
+ * Draws a DebugDrawList on top of whatever is bound, in a single
+ * glDrawArrays from a buffer of its own, with the untextured program
+ * (shaders/vertex.glsl and fragment.glsl, or their _330 versions on a core
+ * context). Needs the GL context current, destruction included.
+ *
+ * Debug builds only; without DEBUG this header is empty.
+ */
+class DebugDraw {
+public:
+    static const GLuint POSITION_LOCATION = 0;   // fixed in vertex_330.glsl
+    static const GLuint COLOR_LOCATION = 1;
+
+    DebugDraw(bool coreProfile);
+    ~DebugDraw();
+
+    void Draw(const DebugDrawList &list, RenderDevice &device, ShaderProgram *program,
+              const glm::mat4 &projection, const glm::mat4 &view);
+
+private:
+    void PointAttributes(GLuint position, GLuint color);
+
+    bool coreProfile;
+    GLuint buffer = 0;
+    GLuint vertexArray = 0;   // 0 on a legacy context
+};
+
+#endif /* DEBUG */
+
+#endif /* DebugDraw_h */
@@ -11,8 +11,13 @@
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "ShaderProgram.h"
+#include "RenderQueue.h"
 #include "Entity.h"
 
+const float SPRITE_RECT[]     = { -0.5f, -0.5f, 0.5f, 0.5f };
+const float BACKGROUND_RECT[] = { -5.0f, -5.0f, 5.0f, 5.0f };
+const float FULL_UV[]         = {  0.0f,  0.0f, 1.0f, 1.0f };
+
 Entity::Entity()
 {
     position     = glm::vec3(0.0f);
@@ -22,7 +27,6 @@ Entity::Entity()
     movement = glm::vec3(0.0f);
     
     speed = 0;
-    modelMatrix = glm::mat4(1.0f);
 }
 
 Entity::~Entity()
@@ -34,7 +38,7 @@ Entity::~Entity()
     delete [] walking;
 }
 
-void Entity::draw_sprite_from_texture_atlas(ShaderProgram *program, GLuint texture_id, int index)
+void Entity::draw_sprite_from_texture_atlas(RenderQueue *queue, ShaderProgram *program, GLuint texture_id, int index)
 {
     // Step 1: Calculate the UV location of the indexed frame
     float u_coord = (float) (index % animation_cols) / (float) animation_cols;
@@ -44,32 +48,12 @@ void Entity::draw_sprite_from_texture_atlas(ShaderProgram *program, GLuint textu
     float width = 1.0f / (float) animation_cols;
     float height = 1.0f / (float) animation_rows;
     
-    // Step 3: Just as we have done before, match the texture coordinates to the vertices
-    float tex_coords[] =
-    {
-        u_coord, v_coord + height, u_coord + width, v_coord + height, u_coord + width, v_coord,
-        u_coord, v_coord + height, u_coord + width, v_coord, u_coord, v_coord
-    };
-    
-    float vertices[] =
-    {
-        -0.5, -0.5, 0.5, -0.5,  0.5, 0.5,
-        -0.5, -0.5, 0.5,  0.5, -0.5, 0.5
-    };
-    
-    // Step 4: And render
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-    glEnableVertexAttribArray(program->positionAttribute);
-    
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, tex_coords);
-    glEnableVertexAttribArray(program->texCoordAttribute);
+    // Step 3: Hand the frame's UV rectangle to the queue along with the quad,
+    // with the palette row in u
+    u_coord += 2.0f * palette_row;
+    float uv[] = { u_coord, v_coord, u_coord + width, v_coord + height };
     
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+    queue->SubmitQuad(LAYER_ACTORS, 0.0f, program, texture_id, transform, SPRITE_RECT, uv);
 }
 
 void Entity::Activate_ai(Entity *player)
@@ -179,7 +163,7 @@ void Entity::Update(float deltaTime, Entity *player, Entity *platforms, Entity *
     
     if (entityType == ENEMY) {Activate_ai(player);}
     
-    if (animation_indices != NULL){
+    if (animation_indices != NULL && animation_clip < 0){
        if (glm::length(movement) != 0){
            animation_time += deltaTime;
            float frames_per_second = (float) 1 / SECONDS_PER_FRAME;
@@ -238,55 +222,45 @@ void Entity::Update(float deltaTime, Entity *player, Entity *platforms, Entity *
     position.x += velocity.x * deltaTime;
     position.y += velocity.y * deltaTime;
     
-    modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, position);
+    transformDirty = true;
 }
 
-void Entity::renderbg(ShaderProgram* program){
-    program->SetModelMatrix(modelMatrix);
-
-    float vertices[] = { -5, -5, 5, -5, 5, 5, -5, -5, 5, 5, -5, 5 };
-    float tex_coords[] = { 0.0,  1.0, 1.0,  1.0, 1.0, 0.0,  0.0,  1.0, 1.0, 0.0,  0.0, 0.0 };
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-    glEnableVertexAttribArray(program->positionAttribute);
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, tex_coords);
-    glEnableVertexAttribArray(program->texCoordAttribute);
-
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+void Entity::renderbg(RenderQueue *queue, ShaderProgram* program){
+    queue->SubmitQuad(LAYER_BACKGROUND, 0.0f, program, textureID, transform, BACKGROUND_RECT, FULL_UV);
 }
 
-void Entity::render(ShaderProgram *program)
+void Entity::render(RenderQueue *queue, ShaderProgram *program, ShaderProgram *animatedProgram)
 {
     if (!isActive) return;
     
-    program->SetModelMatrix(modelMatrix);
+    if (transformDirty)
+    {
+        transform.position = glm::vec2(position);
+        transformDirty = false;
+    }
     
-    if (animation_indices != NULL)
+    // Standing still shows the clip's first frame, as a plain sprite
+    if (animation_clip >= 0 && glm::length(movement) != 0)
     {
-        draw_sprite_from_texture_atlas(program, textureID, animation_indices[animation_index]);
+        queue->SubmitAnimated(LAYER_ACTORS, 0.0f, animatedProgram != NULL ? animatedProgram : program, textureID, transform,
+                              SPRITE_RECT, animation_clip, animation_phase);
+        return;
+    }
+    if (animation_clip >= 0 && animation_indices != NULL)
+    {
+        draw_sprite_from_texture_atlas(queue, program, textureID, animation_indices[0]);
         return;
     }
     
-    float vertices[]   = { -0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5 };
-    float tex_coords[] = {  0.0,  1.0, 1.0,  1.0, 1.0, 0.0,  0.0,  1.0, 1.0, 0.0,  0.0, 0.0 };
-    
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-    glEnableVertexAttribArray(program->positionAttribute);
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, tex_coords);
-    glEnableVertexAttribArray(program->texCoordAttribute);
-    
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    if (animation_indices != NULL)
+    {
+        draw_sprite_from_texture_atlas(queue, program, textureID, animation_indices[animation_index]);
+        return;
+    }
     
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+    RenderLayer layer = entityType == PLATFORM ? LAYER_WORLD : LAYER_ACTORS;
+    float uv[] = { FULL_UV[0] + 2.0f * palette_row, FULL_UV[1], FULL_UV[2] + 2.0f * palette_row, FULL_UV[3] };
+    queue->SubmitQuad(layer, 0.0f, program, textureID, transform, SPRITE_RECT, uv);
 }
 
 
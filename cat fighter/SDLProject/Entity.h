@@ -1,3 +1,7 @@
+#include "Transform2D.h"
+
+class RenderQueue;
+
 enum EntityType { PLATFORM, PLAYER, ENEMY, FIREBALL };
 enum AIType     { WALKER, GUARD, JUMP };
 enum AIState    { WALKING, IDLE, ATTACKING };
@@ -14,7 +18,12 @@ public:
     glm::vec3 velocity;
     
     GLuint textureID;
-    glm::mat4 modelMatrix;
+    
+    // What the renderer draws from. Update only marks it stale; render()
+    // catches it up with position, so entities that are never drawn never
+    // pay for it. One that has never been updated stays at the origin.
+    Transform2D transform;
+    bool transformDirty = false;
     
     float width = 1.0;
     float height = 1.0;
@@ -56,6 +65,15 @@ public:
     float animation_time   = 0.0f;
     int animation_cols     = 0;
     int animation_rows     = 0;
+    
+    // A SpriteAnimation clip to play while moving, animated by the renderer
+    // instead of Update; -1 steps animation_indices as above
+    int animation_clip     = -1;
+    int animation_phase    = 0;
+    
+    // Which palette row an indexed texture is drawn with; 0 is its own
+    // colours. Clips animated on the GPU always use row 0.
+    int palette_row        = 0;
 
     
     Entity();
@@ -65,11 +83,11 @@ public:
     void CheckCollisionY(Entity *objects, int objectCount);
     void CheckCollisionX(Entity *objects, int objectCount);
     
-    void draw_sprite_from_texture_atlas(ShaderProgram *program, GLuint texture_id, int index);
+    void draw_sprite_from_texture_atlas(RenderQueue *queue, ShaderProgram *program, GLuint texture_id, int index);
     bool areEnemiesActive(Entity *enemies, int enemyCount);
     void Update(float deltaTime, Entity *player, Entity *platforms, Entity *enemies, int platformCount, int enemyCount, Entity *bullets);
-    void render(ShaderProgram *program);
-    void renderbg(ShaderProgram* program);
+    void render(RenderQueue *queue, ShaderProgram *program, ShaderProgram *animatedProgram = NULL);
+    void renderbg(RenderQueue *queue, ShaderProgram* program);
     
     void Activate_ai(Entity *player);
     void ai_walker();
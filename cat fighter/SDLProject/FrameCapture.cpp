@@ -0,0 +1,131 @@
+//
+//  FrameCapture.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+#define LOG(argument) std::cout << argument << '\n'
+
+#include <cstring>
+#include <iostream>
+#include "FrameCapture.h"
+
+FrameCapture::FrameCapture(int width, int height) : width(width), height(height)
+{
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorbuffer);
+    glGenRenderbuffers(1, &depthbuffer);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colorbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    complete = status == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete) LOG("Offscreen framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ").");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (Slot &slot : slots)
+    {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameCapture::~FrameCapture()
+{
+    for (Slot &slot : slots) glDeleteBuffers(1, &slot.buffer);
+    glDeleteRenderbuffers(1, &colorbuffer);
+    glDeleteRenderbuffers(1, &depthbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+void FrameCapture::Bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+void FrameCapture::Unbind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameCapture::Readback(int frame)
+{
+    // Only when readbacks come faster than the latency does this have to wait
+    Slot &slot = slots[nextSlot];
+    if (slot.frame >= 0)
+    {
+        LOG("Capture ring full, waiting on frame " << slot.frame << ".");
+        Finish(slot);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);   // into the buffer, returns at once
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.frame = frame;
+    slot.submitted = ++readbacks;
+    nextSlot = (nextSlot + 1) % RING_SIZE;
+}
+
+void FrameCapture::Collect(std::vector<CapturedFrame> &finished, bool drain)
+{
+    // Oldest first, starting from the slot the next readback would reuse
+    for (int i = 0; i < RING_SIZE; i++)
+    {
+        Slot &slot = slots[(nextSlot + i) % RING_SIZE];
+        if (slot.frame < 0) continue;
+        if (!drain && readbacks - slot.submitted < READBACK_LATENCY) continue;
+
+        Finish(slot);
+    }
+
+    for (CapturedFrame &captured : ready) finished.push_back(std::move(captured));
+    ready.clear();
+}
+
+void FrameCapture::Finish(Slot &slot)
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const unsigned char *pixels = (const unsigned char *) glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+
+    if (pixels != NULL)
+    {
+        ready.emplace_back();
+        CapturedFrame &captured = ready.back();
+        captured.frame = slot.frame;
+        captured.image.width = width;
+        captured.image.height = height;
+        captured.image.pixels.resize(width * height * 4);
+
+        // GL rows start at the bottom
+        size_t rowBytes = width * 4;
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(&captured.image.pixels[y * rowBytes], pixels + (height - 1 - y) * rowBytes, rowBytes);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else
+    {
+        LOG("Unable to map the readback of frame " << slot.frame << ".");
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.frame = -1;
+}
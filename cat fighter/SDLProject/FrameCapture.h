@@ -0,0 +1,79 @@
+//
+//  FrameCapture.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef FrameCapture_h
+#define FrameCapture_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "ImageIO.h"
+
+struct CapturedFrame {
+    int frame;
+    Image image;
+};
+
+/**
+ * An offscreen framebuffer of any size, plus asynchronous readback.
+ *
+ * Bind() redirects drawing into the framebuffer object. Readback() starts a
+ * glReadPixels into the next pixel buffer of a small ring and returns
+ * straight away; Collect() maps the buffers whose copies are at least
+ * READBACK_LATENCY frames old, by which time the GPU has long finished with
+ * them, so reading frames back never stalls the pipeline. Everything here
+ * needs the GL context current.
+ */
+class FrameCapture {
+public:
+    static const int RING_SIZE = 3;
+    static const int READBACK_LATENCY = 2;
+
+    FrameCapture(int width, int height);
+    ~FrameCapture();
+
+    bool IsComplete() const { return complete; }
+
+    void Bind();
+    void Unbind();
+
+    void Readback(int frame);
+
+    // Moves finished readbacks out in frame order; `drain` waits for all of them
+    void Collect(std::vector<CapturedFrame> &finished, bool drain);
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        int frame = -1;        // -1 when free
+        int submitted = 0;     // Readback() count when the copy was issued
+    };
+
+    void Finish(Slot &slot);
+
+    int width;
+    int height;
+    bool complete = false;
+
+    GLuint framebuffer = 0;
+    GLuint colorbuffer = 0;
+    GLuint depthbuffer = 0;   // for RenderDevice's materials
+
+    Slot slots[RING_SIZE];
+    std::vector<CapturedFrame> ready;
+    int nextSlot = 0;
+    int readbacks = 0;
+};
+
+#endif /* FrameCapture_h */
@@ -0,0 +1,122 @@
+//
+//  FramePacer.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "FramePacer.h"
+
+const double MIN_SPIN_MARGIN = 0.0005;
+const double MAX_SPIN_MARGIN = 0.004;
+
+VsyncMode set_vsync(VsyncMode requested)
+{
+    // Adaptive vsync (late swaps tear instead of waiting a whole extra
+    // refresh) is interval -1 and not every driver has it
+    if (requested == VSYNC_ADAPTIVE)
+    {
+        if (SDL_GL_SetSwapInterval(-1) == 0) return VSYNC_ADAPTIVE;
+        requested = VSYNC_ON;
+    }
+
+    if (requested == VSYNC_ON && SDL_GL_SetSwapInterval(1) == 0) return VSYNC_ON;
+
+    SDL_GL_SetSwapInterval(0);
+    return VSYNC_OFF;
+}
+
+FramePacer::FramePacer(double targetFps)
+{
+    start = SDL_GetPerformanceCounter();
+    frequency = (double) SDL_GetPerformanceFrequency();
+    SetTargetFps(targetFps);
+}
+
+double FramePacer::Now() const
+{
+    return (double) (SDL_GetPerformanceCounter() - start) / frequency;
+}
+
+void FramePacer::SetTargetFps(double fps)
+{
+    period = 1.0 / fps;
+    nextDeadline = Now() + period;
+}
+
+void FramePacer::WaitUntil(double seconds)
+{
+    double remaining = seconds - Now();
+
+    // Coarse sleep, leaving the spin margin for the scheduler's slop
+    if (remaining > spinMargin)
+    {
+        Uint32 milliseconds = (Uint32) ((remaining - spinMargin) * 1000.0);
+        if (milliseconds > 0)
+        {
+            double before = Now();
+            SDL_Delay(milliseconds);
+            double overshoot = (Now() - before) - milliseconds / 1000.0;
+
+            // Track how late the OS wakes us, slowly, within sane bounds
+            spinMargin = std::min(MAX_SPIN_MARGIN, std::max(MIN_SPIN_MARGIN, spinMargin * 0.9 + (overshoot + MIN_SPIN_MARGIN) * 0.1));
+        }
+    }
+
+    while (Now() < seconds) std::this_thread::yield();
+}
+
+void FramePacer::WaitForNextFrame()
+{
+    WaitUntil(nextDeadline);
+
+    // Stay on the fixed schedule, but after a long stall start over from now
+    // rather than rushing out a burst of frames to catch up
+    nextDeadline += period;
+    double now = Now();
+    if (nextDeadline < now) nextDeadline = now + period;
+}
+
+void FramePacer::FrameCompleted()
+{
+    double now = Now();
+    if (lastFrame >= 0)
+    {
+        intervals[intervalNext] = now - lastFrame;
+        intervalNext = (intervalNext + 1) % HISTORY;
+        intervalCount = std::min(intervalCount + 1, HISTORY);
+    }
+    lastFrame = now;
+}
+
+FrameTimingStats FramePacer::Stats() const
+{
+    FrameTimingStats stats;
+    stats.frames = intervalCount;
+    if (intervalCount == 0) return stats;
+
+    double sum = 0;
+    stats.minSeconds = intervals[0];
+    stats.maxSeconds = intervals[0];
+    for (int i = 0; i < intervalCount; i++)
+    {
+        sum += intervals[i];
+        stats.minSeconds = std::min(stats.minSeconds, intervals[i]);
+        stats.maxSeconds = std::max(stats.maxSeconds, intervals[i]);
+        if (intervals[i] > period * 1.5) stats.missedFrames++;
+    }
+    stats.meanSeconds = sum / intervalCount;
+
+    double variance = 0;
+    for (int i = 0; i < intervalCount; i++)
+    {
+        double difference = intervals[i] - stats.meanSeconds;
+        variance += difference * difference;
+    }
+    stats.jitterSeconds = std::sqrt(variance / intervalCount);
+
+    return stats;
+}
@@ -0,0 +1,72 @@
+//
+//  FramePacer.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef FramePacer_h
+#define FramePacer_h
+
+#include <SDL.h>
+
+enum VsyncMode { VSYNC_OFF, VSYNC_ON, VSYNC_ADAPTIVE };
+
+/**
+ * Asks for the given swap interval on the current GL context, stepping down
+ * from adaptive to regular vsync to none until the driver accepts one.
+ * Returns what was actually set.
+ */
+VsyncMode set_vsync(VsyncMode requested);
+
+struct FrameTimingStats {
+    int frames = 0;
+    double meanSeconds = 0;
+    double jitterSeconds = 0;   // standard deviation of the frame interval
+    double minSeconds = 0;
+    double maxSeconds = 0;
+    int missedFrames = 0;       // intervals more than half a period late
+};
+
+/**
+ * High-resolution frame clock built on SDL_GetPerformanceCounter.
+ *
+ * WaitForNextFrame() sleeps until the next deadline of a fixed-rate
+ * schedule: SDL_Delay covers most of the wait and a short yield loop lands
+ * the rest precisely. The spin margin follows how late SDL_Delay has
+ * actually been waking up on this machine, so the loop spins for a fraction
+ * of a millisecond rather than burning a core.
+ */
+class FramePacer {
+public:
+    FramePacer(double targetFps);
+
+    double Now() const;
+
+    void SetTargetFps(double fps);
+    double Period() const { return period; }
+
+    void WaitUntil(double seconds);
+    void WaitForNextFrame();
+
+    // Call once per presented frame to feed the jitter statistics
+    void FrameCompleted();
+    FrameTimingStats Stats() const;
+
+private:
+    static const int HISTORY = 120;
+
+    Uint64 start;
+    double frequency;
+    double period;
+
+    double nextDeadline = 0;
+    double spinMargin = 0.002;
+
+    double lastFrame = -1;
+    double intervals[HISTORY];
+    int intervalCount = 0;
+    int intervalNext = 0;
+};
+
+#endif /* FramePacer_h */
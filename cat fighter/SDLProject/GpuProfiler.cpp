@@ -0,0 +1,194 @@
+//
+//  GpuProfiler.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+
+#include <algorithm>
+#include "GpuProfiler.h"
+
+// Same value for the ARB, EXT and core 3.3 names; older headers only have some
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+const double NANOSECONDS_PER_MILLISECOND = 1000000.0;
+
+GpuProfiler::GpuProfiler(const std::vector<std::string> &passNames) : passNames(passNames)
+{
+    // Core in 3.3, where drivers need not list the extension any more
+    int major = 0, minor = 0;
+    const char *version = (const char *) glGetString(GL_VERSION);
+    if (version != NULL) sscanf(version, "%d.%d", &major, &minor);
+
+    timerQueries = major > 3 || (major == 3 && minor >= 3)
+                || SDL_GL_ExtensionSupported("GL_ARB_timer_query") || SDL_GL_ExtensionSupported("GL_EXT_timer_query");
+
+    int passCount = (int) passNames.size();
+    for (FrameSlot &slot : slots)
+    {
+        slot.queries.resize(passCount);
+        slot.issued.resize(passCount);
+        slot.cpuMilliseconds.resize(passCount);
+    }
+
+    latest.resize(passCount);
+    for (int pass = 0; pass < passCount; pass++) latest[pass].name = passNames[pass];
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    if (timerQueries)
+    {
+        for (FrameSlot &slot : slots)
+        {
+            for (std::vector<GLuint> &pieces : slot.queries) glDeleteQueries((GLsizei) pieces.size(), pieces.data());
+        }
+    }
+    if (log != NULL) fclose(log);
+}
+
+double GpuProfiler::Now() const
+{
+    return (double) SDL_GetPerformanceCounter() * 1000.0 / (double) SDL_GetPerformanceFrequency();
+}
+
+bool GpuProfiler::OpenLog(const char *path)
+{
+    log = fopen(path, "w");
+    if (log == NULL) return false;
+
+    fprintf(log, "frame,frame_cpu_ms");
+    for (const std::string &name : passNames) fprintf(log, ",%s_gpu_ms,%s_cpu_ms", name.c_str(), name.c_str());
+    fprintf(log, "\n");
+    return true;
+}
+
+void GpuProfiler::BeginFrame()
+{
+    // Oldest first, so results come out in frame order. The oldest frame is
+    // about to lose its slot, so if it still isn't done it is dropped;
+    // anything newer just gets another frame.
+    for (int frame = std::max(0, frameCount - RING_SIZE); frame < frameCount; frame++)
+    {
+        FrameSlot &slot = slots[frame % RING_SIZE];
+        if (slot.frame != frame) continue;
+
+        if (Collect(slot))
+        {
+            WriteLogRow();
+        }
+        else if (frame == frameCount - RING_SIZE)
+        {
+            slot.frame = -1;
+            droppedFrames++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    FrameSlot &slot = slots[frameCount % RING_SIZE];
+    slot.frame = frameCount;
+    std::fill(slot.issued.begin(), slot.issued.end(), 0);
+    std::fill(slot.cpuMilliseconds.begin(), slot.cpuMilliseconds.end(), 0.0);
+
+    frameStart = Now();
+}
+
+void GpuProfiler::BeginPass(int pass)
+{
+    if (activePass >= 0) EndPass();
+
+    // Queries are made as a pass first needs them and kept from then on
+    FrameSlot &slot = slots[frameCount % RING_SIZE];
+    std::vector<GLuint> &pieces = slot.queries[pass];
+    if (timerQueries)
+    {
+        if (slot.issued[pass] == (int) pieces.size())
+        {
+            pieces.push_back(0);
+            glGenQueries(1, &pieces.back());
+        }
+        glBeginQuery(GL_TIME_ELAPSED, pieces[slot.issued[pass]]);
+    }
+    slot.issued[pass]++;
+
+    activePass = pass;
+    passStart = Now();
+}
+
+void GpuProfiler::EndPass()
+{
+    if (activePass < 0) return;
+
+    FrameSlot &slot = slots[frameCount % RING_SIZE];
+    if (timerQueries) glEndQuery(GL_TIME_ELAPSED);
+    slot.cpuMilliseconds[activePass] += Now() - passStart;
+
+    activePass = -1;
+}
+
+void GpuProfiler::EndFrame()
+{
+    EndPass();
+    slots[frameCount % RING_SIZE].frameCpuMilliseconds = Now() - frameStart;
+    frameCount++;
+}
+
+bool GpuProfiler::Collect(FrameSlot &slot)
+{
+    int passCount = (int) passNames.size();
+
+    if (timerQueries)
+    {
+        for (int pass = 0; pass < passCount; pass++)
+        {
+            for (int piece = 0; piece < slot.issued[pass]; piece++)
+            {
+                GLuint available = GL_FALSE;
+                glGetQueryObjectuiv(slot.queries[pass][piece], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) return false;
+            }
+        }
+    }
+
+    for (int pass = 0; pass < passCount; pass++)
+    {
+        PassTiming &timing = latest[pass];
+        timing.drawn = slot.issued[pass] > 0;
+        timing.cpuMilliseconds = slot.cpuMilliseconds[pass];
+        timing.gpuMilliseconds = 0;
+
+        // 32 bits of nanoseconds is over four seconds, plenty for one pass
+        for (int piece = 0; timerQueries && piece < slot.issued[pass]; piece++)
+        {
+            GLuint nanoseconds = 0;
+            glGetQueryObjectuiv(slot.queries[pass][piece], GL_QUERY_RESULT, &nanoseconds);
+            timing.gpuMilliseconds += nanoseconds / NANOSECONDS_PER_MILLISECOND;
+        }
+    }
+
+    latestFrame = slot.frame;
+    latestFrameCpu = slot.frameCpuMilliseconds;
+    slot.frame = -1;
+    return true;
+}
+
+void GpuProfiler::WriteLogRow()
+{
+    if (log == NULL) return;
+
+    fprintf(log, "%d,%.4f", latestFrame, latestFrameCpu);
+    for (const PassTiming &timing : latest)
+    {
+        if (!timing.drawn) fprintf(log, ",,");
+        else if (!timerQueries) fprintf(log, ",,%.4f", timing.cpuMilliseconds);
+        else fprintf(log, ",%.4f,%.4f", timing.gpuMilliseconds, timing.cpuMilliseconds);
+    }
+    fprintf(log, "\n");
+}
@@ -0,0 +1,99 @@
+//
+//  GpuProfiler.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef GpuProfiler_h
+#define GpuProfiler_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct PassTiming {
+    std::string name;
+    bool drawn = false;          // false when nothing was submitted in this pass
+    double gpuMilliseconds = 0;
+    double cpuMilliseconds = 0;  // time spent issuing the pass's GL calls
+};
+
+/**
+ * Per-pass GPU and CPU timings for the render thread.
+ *
+ * Each pass is bracketed by a GL_TIME_ELAPSED query. Queries live in a ring
+ * of RING_SIZE frames and are only read once GL_QUERY_RESULT_AVAILABLE says
+ * so, which is normally a couple of frames later; a frame whose results are
+ * still not in when its slot comes round again is dropped rather than
+ * waited for. Without GL 3.3, ARB_timer_query or EXT_timer_query only the
+ * CPU side is reported.
+ *
+ * A pass may be begun more than once in a frame, as when its draws are
+ * split between materials; each piece gets a query of its own and the
+ * pieces are added up.
+ *
+ * Needs the GL context current for everything, construction included.
+ */
+class GpuProfiler {
+public:
+    static const int RING_SIZE = 4;
+
+    GpuProfiler(const std::vector<std::string> &passNames);
+    ~GpuProfiler();
+
+    bool HasTimerQueries() const { return timerQueries; }
+
+    // Appends one CSV row per frame as its results arrive
+    bool OpenLog(const char *path);
+
+    void BeginFrame();
+    void BeginPass(int pass);
+    void EndPass();
+    void EndFrame();
+
+    // The most recent frame with results in, and its frame number (-1 before any)
+    const std::vector<PassTiming> &Latest() const { return latest; }
+    int LatestFrame() const { return latestFrame; }
+    double LatestFrameCpuMilliseconds() const { return latestFrameCpu; }
+
+    int DroppedFrames() const { return droppedFrames; }
+
+private:
+    struct FrameSlot {
+        int frame = -1;                 // -1 when nothing is waiting in this slot
+        std::vector<std::vector<GLuint>> queries;   // per pass, one per piece
+        std::vector<int> issued;                    // pieces begun this frame, per pass
+        std::vector<double> cpuMilliseconds;
+        double frameCpuMilliseconds = 0;
+    };
+
+    double Now() const;
+    bool Collect(FrameSlot &slot);
+    void WriteLogRow();
+
+    std::vector<std::string> passNames;
+    bool timerQueries;
+
+    FrameSlot slots[RING_SIZE];
+    int frameCount = 0;
+    int activePass = -1;
+    double passStart = 0;
+    double frameStart = 0;
+
+    std::vector<PassTiming> latest;
+    int latestFrame = -1;
+    double latestFrameCpu = 0;
+    int droppedFrames = 0;
+
+    FILE *log = NULL;
+};
+
+#endif /* GpuProfiler_h */
@@ -0,0 +1,163 @@
+//
+//  ImageIO.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include "ImageIO.h"
+#include "stb_image.h"
+
+const int MAX_STORED_BLOCK = 65535;
+
+static uint32_t crc32(const unsigned char *data, size_t length, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void append_u32(std::vector<unsigned char> &out, uint32_t value)
+{
+    out.push_back((unsigned char) (value >> 24));
+    out.push_back((unsigned char) (value >> 16));
+    out.push_back((unsigned char) (value >> 8));
+    out.push_back((unsigned char) value);
+}
+
+static void append_chunk(std::vector<unsigned char> &out, const char type[4], const std::vector<unsigned char> &data)
+{
+    append_u32(out, (uint32_t) data.size());
+
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+
+    // The CRC covers the type and the data, not the length
+    append_u32(out, crc32(&out[start], out.size() - start));
+}
+
+bool write_png(const std::string &path, const Image &image)
+{
+    // Scanlines, each with filter type 0 in front
+    size_t rowBytes = image.width * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), &image.pixels[y * rowBytes], &image.pixels[y * rowBytes] + rowBytes);
+    }
+
+    // zlib stream made of stored deflate blocks
+    std::vector<unsigned char> compressed = { 0x78, 0x01 };
+    uint32_t adlerA = 1, adlerB = 0;
+    for (size_t offset = 0; offset < raw.size() || offset == 0; offset += MAX_STORED_BLOCK)
+    {
+        size_t length = std::min(raw.size() - offset, (size_t) MAX_STORED_BLOCK);
+        bool last = offset + length >= raw.size();
+
+        compressed.push_back(last ? 1 : 0);
+        compressed.push_back((unsigned char) length);
+        compressed.push_back((unsigned char) (length >> 8));
+        compressed.push_back((unsigned char) ~length);
+        compressed.push_back((unsigned char) (~length >> 8));
+        compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + length);
+
+        for (size_t i = offset; i < offset + length; i++)
+        {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        if (last) break;
+    }
+    append_u32(compressed, (adlerB << 16) | adlerA);
+
+    std::vector<unsigned char> header;
+    append_u32(header, image.width);
+    append_u32(header, image.height);
+    header.push_back(8);   // bits per channel
+    header.push_back(6);   // RGBA
+    header.push_back(0);   // deflate
+    header.push_back(0);   // adaptive filtering
+    header.push_back(0);   // not interlaced
+
+    const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<unsigned char> file(signature, signature + sizeof(signature));
+    append_chunk(file, "IHDR", header);
+    append_chunk(file, "IDAT", compressed);
+    append_chunk(file, "IEND", std::vector<unsigned char>());
+
+    FILE *output = fopen(path.c_str(), "wb");
+    if (output == NULL) return false;
+    bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+    return fclose(output) == 0 && written;
+}
+
+bool load_image(const std::string &path, Image *image)
+{
+    int components;
+    unsigned char *pixels = stbi_load(path.c_str(), &image->width, &image->height, &components, STBI_rgb_alpha);
+    if (pixels == NULL) return false;
+
+    image->pixels.assign(pixels, pixels + image->width * image->height * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+ImageDifference compare_images(const Image &a, const Image &b, int tolerance)
+{
+    ImageDifference difference;
+    for (size_t pixel = 0; pixel < a.pixels.size(); pixel += 4)
+    {
+        int worst = 0;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            worst = std::max(worst, std::abs(a.pixels[pixel + channel] - b.pixels[pixel + channel]));
+        }
+
+        difference.maxChannelDifference = std::max(difference.maxChannelDifference, worst);
+        if (worst > tolerance) difference.pixelsOverTolerance++;
+    }
+    return difference;
+}
+
+Image difference_image(const Image &a, const Image &b, int tolerance)
+{
+    Image result;
+    result.width = a.width;
+    result.height = a.height;
+    result.pixels.resize(a.pixels.size());
+
+    for (size_t pixel = 0; pixel < a.pixels.size(); pixel += 4)
+    {
+        bool over = false;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            int difference = std::abs(a.pixels[pixel + channel] - b.pixels[pixel + channel]);
+            if (difference > tolerance) over = true;
+            if (channel < 3) result.pixels[pixel + channel] = (unsigned char) std::min(255, difference * 4);
+        }
+        if (!over) std::fill(&result.pixels[pixel], &result.pixels[pixel] + 3, 0);
+        result.pixels[pixel + 3] = 255;
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+//
+//  ImageIO.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef ImageIO_h
+#define ImageIO_h
+
+#include <string>
+#include <vector>
+
+/**
+ * A captured frame: RGBA8, top row first, rows tightly packed.
+ */
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+struct ImageDifference {
+    int maxChannelDifference = 0;
+    int pixelsOverTolerance = 0;   // pixels with any channel off by more than the tolerance
+};
+
+/**
+ * Writes an 8-bit RGBA PNG. The image data is stored uncompressed, which
+ * keeps the writer tiny at the cost of file size.
+ */
+bool write_png(const std::string &path, const Image &image);
+
+/**
+ * Reads any image stb_image understands, expanded to RGBA8.
+ */
+bool load_image(const std::string &path, Image *image);
+
+/**
+ * Per-channel comparison of two images of the same size.
+ */
+ImageDifference compare_images(const Image &a, const Image &b, int tolerance);
+
+/**
+ * Black where the images agree within the tolerance, the absolute
+ * difference (boosted to be visible) where they do not.
+ */
+Image difference_image(const Image &a, const Image &b, int tolerance);
+
+#endif /* ImageIO_h */
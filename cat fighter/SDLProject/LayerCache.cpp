@@ -0,0 +1,104 @@
+//
+//  LayerCache.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+#define LOG(argument) std::cout << argument << '\n'
+
+#include <iostream>
+#include "glm/gtc/matrix_transform.hpp"
+#include "LayerCache.h"
+#include "RenderDevice.h"
+
+LayerCache::LayerCache(int width, int height, int margin) : width(width), height(height), margin(margin)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width + 2 * margin, height + 2 * margin, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width + 2 * margin, height + 2 * margin);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    complete = status == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete) LOG("Layer cache framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ").");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+LayerCache::~LayerCache()
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthbuffer);
+    glDeleteTextures(1, &texture);
+}
+
+bool LayerCache::Update(RenderQueue &queue, RenderDevice &device, ShaderProgram *program, GpuProfiler *profiler,
+                        const glm::mat4 &projection, const glm::mat4 &view)
+{
+    Bounds2D visible = view_bounds(projection, view);
+    float visibleWidth = visible.right - visible.left;
+    float visibleHeight = visible.top - visible.bottom;
+    uint64_t current = queue.LayerSignature(FIRST_LAYER, LAST_LAYER);
+
+    bool inside = visible.left >= cached.left && visible.right <= cached.right
+               && visible.bottom >= cached.bottom && visible.top <= cached.top;
+    if (valid && inside && visibleWidth == viewWidth && visibleHeight == viewHeight && current == signature) return false;
+
+    // Whole pixels of margin keep texels on the screen's pixel grid
+    float pixelWidth = visibleWidth / width;
+    float pixelHeight = visibleHeight / height;
+    cached.left   = visible.left - margin * pixelWidth;
+    cached.right  = visible.right + margin * pixelWidth;
+    cached.bottom = visible.bottom - margin * pixelHeight;
+    cached.top    = visible.top + margin * pixelHeight;
+
+    viewWidth = visibleWidth;
+    viewHeight = visibleHeight;
+    signature = current;
+    valid = true;
+    redraws++;
+
+    // Transparent, so the composite blends over the frame's clear colour like a direct draw would
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width + 2 * margin, height + 2 * margin);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+    glm::mat4 cachedProjection = glm::ortho(cached.left, cached.right, cached.bottom, cached.top, -1.0f, 1.0f);
+    device.SetCamera(program, cachedProjection, glm::mat4(1.0f));
+    queue.Execute(device, profiler, FIRST_LAYER, LAST_LAYER);
+
+    return true;
+}
+
+void LayerCache::Composite(RenderDevice &device, ShaderProgram *program)
+{
+    if (!valid) return;
+
+    const float rect[] = { cached.left, cached.bottom, cached.right, cached.top };
+    const float uv[] = { 0.0f, 1.0f, 1.0f, 0.0f };   // framebuffer rows run bottom up
+
+    compositeQueue.Clear();
+    compositeQueue.SubmitQuad(FIRST_LAYER, 0.0f, program, texture, glm::mat4(1.0f), rect, uv);
+    compositeQueue.Sort();
+    compositeQueue.Execute(device);
+}
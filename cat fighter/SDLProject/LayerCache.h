@@ -0,0 +1,82 @@
+//
+//  LayerCache.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef LayerCache_h
+#define LayerCache_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stdint.h>
+#include "glm/mat4x4.hpp"
+#include "Culling.h"
+#include "RenderQueue.h"
+
+class RenderDevice;
+class GpuProfiler;
+
+/**
+ * The static layers, FIRST_LAYER to LAST_LAYER, drawn once into a texture
+ * and composited from it every frame as a single quad.
+ *
+ * The texture covers the view plus a margin of `margin` pixels on every
+ * side, at the same pixel size as the screen. Update() redraws it only
+ * when the view moves beyond the margin, zooms, or anything drawn in the
+ * cached layers changes (see RenderQueue::LayerSignature()); Invalidate()
+ * forces a redraw for changes the queue cannot see, such as a texture
+ * finishing loading. Everything in between is one textured quad.
+ *
+ * Texels sit on the screen's pixel grid while the camera is still; while
+ * it moves, each pixel takes the nearest cached texel, so the static
+ * layers can be up to half a pixel off from where a direct draw would put
+ * them. Needs the GL context current, destruction included.
+ */
+class LayerCache {
+public:
+    static const RenderLayer FIRST_LAYER = LAYER_BACKGROUND;
+    static const RenderLayer LAST_LAYER = LAYER_WORLD;
+
+    LayerCache(int width, int height, int margin);
+    ~LayerCache();
+
+    bool IsComplete() const { return complete; }
+    void Invalidate() { valid = false; }
+
+    // Redraws the texture if it has to; true if it did. Leaves the cache's
+    // framebuffer bound when it draws.
+    bool Update(RenderQueue &queue, RenderDevice &device, ShaderProgram *program, GpuProfiler *profiler,
+                const glm::mat4 &projection, const glm::mat4 &view);
+
+    // Draws the cached layers into whatever is bound, under the frame's camera
+    void Composite(RenderDevice &device, ShaderProgram *program);
+
+    int Redraws() const { return redraws; }
+
+private:
+    int width;           // of the screen
+    int height;
+    int margin;
+    bool complete = false;
+
+    GLuint framebuffer = 0;
+    GLuint texture = 0;
+    GLuint depthbuffer = 0;
+
+    bool valid = false;
+    Bounds2D cached;     // world area the texture covers
+    float viewWidth = 0;
+    float viewHeight = 0;
+    uint64_t signature = 0;
+    int redraws = 0;
+
+    RenderQueue compositeQueue;
+};
+
+#endif /* LayerCache_h */
@@ -0,0 +1,349 @@
+//
+//  RenderDevice.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+
+#include <algorithm>
+#include "glm/gtc/matrix_transform.hpp"
+#include "RenderDevice.h"
+#include "ShaderProgram.h"
+#include "SpriteAnimation.h"
+
+const int MESH_IDLE_FRAMES = 600;   // frames a mesh can go undrawn before its buffer is freed
+const int STREAM_REGION_VERTICES = 16384;   // starting size of each frame's stream region; grows on demand
+
+const float CUTOUT_THRESHOLD = 0.5f;
+const float DEPTH_STEP = 1.0f / 65536.0f;   // model z between consecutive batches
+const int MAX_DEPTH_ORDER = 65535;          // later batches share the nearest depth
+
+const GLsizei STRIDE = RenderQueue::FLOATS_PER_VERTEX * sizeof(float);
+
+RenderDevice::RenderDevice(bool coreProfile) : coreProfile(coreProfile)
+{
+    if (!coreProfile) return;
+
+    glGenBuffers(1, &cameraBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, cameraBuffer);
+
+    glGenBuffers(1, &clipsBuffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CLIPS_BINDING, clipsBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // The vertex array is pointed at the ring's buffer in BeginDraws()
+    streamRing = new StreamBuffer(STREAM_REGION_VERTICES * STRIDE);
+    glGenVertexArrays(1, &streamArray);
+}
+
+RenderDevice::~RenderDevice()
+{
+    for (auto &entry : meshes)
+    {
+        glDeleteBuffers(1, &entry.second.buffer);
+        if (entry.second.vertexArray != 0) glDeleteVertexArrays(1, &entry.second.vertexArray);
+    }
+
+    if (coreProfile)
+    {
+        glDeleteVertexArrays(1, &streamArray);
+        delete streamRing;
+        glDeleteBuffers(1, &cameraBuffer);
+        glDeleteBuffers(1, &clipsBuffer);
+    }
+}
+
+void RenderDevice::BindUniformBlocks(ShaderProgram *program)
+{
+    GLuint block = glGetUniformBlockIndex(program->programID, "Camera");
+    if (block != GL_INVALID_INDEX) glUniformBlockBinding(program->programID, block, CAMERA_BINDING);
+
+    block = glGetUniformBlockIndex(program->programID, "Clips");
+    if (block != GL_INVALID_INDEX) glUniformBlockBinding(program->programID, block, CLIPS_BINDING);
+}
+
+void RenderDevice::SetCamera(ShaderProgram *program, const glm::mat4 &projection, const glm::mat4 &view)
+{
+    if (!coreProfile)
+    {
+        program->SetProjectionMatrix(projection);
+        program->SetViewMatrix(view);
+        return;
+    }
+
+    // One upload a frame, shared by every program
+    glm::mat4 viewProjection = projection * view;
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &viewProjection[0][0]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void RenderDevice::SetAnimation(ShaderProgram *program, const SpriteAnimation &clips, float time)
+{
+    if (!coreProfile) return;
+
+    // Clips are only ever added, so a count that moved is a table that changed
+    if (clips.ClipCount() != uploadedClips)
+    {
+        std::vector<float> block;
+        clips.Pack(block);
+        glBindBuffer(GL_UNIFORM_BUFFER, clipsBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, block.size() * sizeof(float), block.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploadedClips = clips.ClipCount();
+    }
+
+    glUseProgram(program->programID);
+    glUniform1f(glGetUniformLocation(program->programID, "time"), time);
+}
+
+void RenderDevice::PointAttributes(GLuint position, GLuint texCoord, const float *base)
+{
+    // With a buffer bound, `base` is NULL and the pointers are offsets into it
+    glVertexAttribPointer(position, 2, GL_FLOAT, false, STRIDE, base);
+    glVertexAttribPointer(texCoord, 2, GL_FLOAT, false, STRIDE, base + 2);
+    glEnableVertexAttribArray(position);
+    glEnableVertexAttribArray(texCoord);
+}
+
+float *RenderDevice::BeginDraws(int streamVertices)
+{
+    program = NULL;
+    sourceBound = false;
+
+    if (!coreProfile)
+    {
+        stream.resize(streamVertices * RenderQueue::FLOATS_PER_VERTEX);
+        return stream.data();
+    }
+
+    size_t offset;
+    float *destination = (float *) streamRing->Begin(streamVertices * STRIDE, &offset);
+    streamFirstVertex = (int) (offset / STRIDE);
+    streamOpen = true;
+
+    // Growing the ring gives it a new buffer, which may reuse the old name
+    if (streamRing->Generation() != streamArrayGeneration)
+    {
+        streamArrayGeneration = streamRing->Generation();
+        glBindVertexArray(streamArray);
+        glBindBuffer(GL_ARRAY_BUFFER, streamRing->Buffer());
+        PointAttributes(POSITION_LOCATION, TEXCOORD_LOCATION, NULL);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    return destination;
+}
+
+Material RenderDevice::MaterialOf(GLuint textureID) const
+{
+    if (!DepthOrdered()) return MATERIAL_TRANSLUCENT;
+    return materialLookup(textureID);
+}
+
+void RenderDevice::BeginMaterial(Material next)
+{
+    material = next;
+
+    // The overdraw view adds up every fragment, whatever it would have been
+    if (overdraw)
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+    else if (next == MATERIAL_TRANSLUCENT)
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else
+    {
+        glDisable(GL_BLEND);
+    }
+
+    if (DepthOrdered())
+    {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+    }
+    else
+    {
+        glDisable(GL_DEPTH_TEST);
+    }
+    glDepthMask(next == MATERIAL_TRANSLUCENT ? GL_FALSE : GL_TRUE);
+}
+
+void RenderDevice::ReleaseProgram()
+{
+    if (program == NULL || coreProfile) return;
+
+    glDisableVertexAttribArray(program->positionAttribute);
+    glDisableVertexAttribArray(program->texCoordAttribute);
+}
+
+void RenderDevice::UseProgram(ShaderProgram *next)
+{
+    ReleaseProgram();
+
+    // Vertices are already in world space
+    next->SetModelMatrix(glm::mat4(1.0f));
+    glUniform1f(next->alphaCutoffUniform, material == MATERIAL_CUTOUT ? CUTOUT_THRESHOLD : 0.0f);
+    glUniform1f(next->overdrawUniform, overdraw ? 1.0f / OVERDRAW_LEVELS : 0.0f);
+    glUniform1i(next->paletteUniform, PALETTE_UNIT);
+
+    program = next;
+    sourceBound = false;
+}
+
+RenderDevice::MeshEntry &RenderDevice::Upload(const StaticMesh &mesh)
+{
+    auto found = meshes.find(mesh.id);
+    if (found == meshes.end())
+    {
+        MeshEntry entry;
+        glGenBuffers(1, &entry.buffer);
+        entry.vertexArray = 0;
+        entry.version = mesh.version + 1;   // anything but the mesh's version, to force the upload below
+
+        if (coreProfile)
+        {
+            glGenVertexArrays(1, &entry.vertexArray);
+            glBindVertexArray(entry.vertexArray);
+            glBindBuffer(GL_ARRAY_BUFFER, entry.buffer);
+            PointAttributes(POSITION_LOCATION, TEXCOORD_LOCATION, NULL);
+            glBindVertexArray(0);
+        }
+        found = meshes.emplace(mesh.id, entry).first;
+    }
+
+    MeshEntry &entry = found->second;
+    if (entry.version != mesh.version)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, entry.buffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        entry.version = mesh.version;
+        meshUploads++;
+    }
+    entry.lastUsed = frame;
+
+    return entry;
+}
+
+void RenderDevice::BindVertices(const StaticMesh *mesh)
+{
+    if (sourceBound && mesh == source) return;
+
+    if (mesh != NULL)
+    {
+        MeshEntry &entry = Upload(*mesh);
+        if (coreProfile)
+        {
+            glBindVertexArray(entry.vertexArray);
+        }
+        else
+        {
+            // Attribute pointers remember the buffer bound when they are set
+            glBindBuffer(GL_ARRAY_BUFFER, entry.buffer);
+            PointAttributes(program->positionAttribute, program->texCoordAttribute, NULL);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
+    else if (coreProfile)
+    {
+        glBindVertexArray(streamArray);
+    }
+    else
+    {
+        PointAttributes(program->positionAttribute, program->texCoordAttribute, stream.data());
+    }
+
+    source = mesh;
+    sourceBound = true;
+}
+
+void RenderDevice::Draw(const RenderBatch &batch, int order)
+{
+    if (DepthOrdered())
+    {
+        int depthOrder = std::min(orderBase + order + 1, MAX_DEPTH_ORDER);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, depthOrder * DEPTH_STEP));
+        glUniformMatrix4fv(program->modelMatrixUniform, 1, GL_FALSE, &model[0][0]);
+        orderUsed = std::max(orderUsed, order + 1);
+    }
+
+    // The stream is complete by the first draw
+    if (streamOpen)
+    {
+        streamRing->End();
+        streamOpen = false;
+    }
+
+    if (textureUse != NULL && !textureUse(batch.textureID)) return;
+
+    BindVertices(batch.mesh);
+    glBindTexture(GL_TEXTURE_2D, batch.textureID);
+
+    int paletteRows = 0;
+    GLuint palette = paletteLookup != NULL ? paletteLookup(batch.textureID, &paletteRows) : 0;
+    if (palette != 0)
+    {
+        glActiveTexture(GL_TEXTURE0 + PALETTE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, palette);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glUniform1f(program->paletteRowsUniform, (float) paletteRows);
+
+    int first = batch.firstVertex;
+    if (batch.mesh == NULL && coreProfile) first += streamFirstVertex;
+    glDrawArrays(GL_TRIANGLES, first, batch.vertexCount);
+}
+
+void RenderDevice::EndDraws()
+{
+    ReleaseProgram();
+    if (coreProfile)
+    {
+        glBindVertexArray(0);
+
+        if (streamOpen) streamRing->End();
+        streamOpen = false;
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    orderBase += orderUsed;
+    orderUsed = 0;
+    program = NULL;
+    sourceBound = false;
+}
+
+void RenderDevice::EndFrame()
+{
+    if (coreProfile) streamRing->Fence();
+
+    orderBase = 0;
+    frame++;
+    for (auto entry = meshes.begin(); entry != meshes.end(); )
+    {
+        if (frame - entry->second.lastUsed > MESH_IDLE_FRAMES)
+        {
+            glDeleteBuffers(1, &entry->second.buffer);
+            if (entry->second.vertexArray != 0) glDeleteVertexArrays(1, &entry->second.vertexArray);
+            entry = meshes.erase(entry);
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+}
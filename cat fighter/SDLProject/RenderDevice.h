@@ -0,0 +1,174 @@
+//
+//  RenderDevice.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef RenderDevice_h
+#define RenderDevice_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+
+class ShaderProgram;
+class SpriteAnimation;
+class ThreadPool;
+
+/**
+ * Where a RenderQueue's vertices and camera come from on the GL side, for
+ * either kind of context we can get.
+ *
+ * On a legacy 2.1 context the frame's vertex stream is drawn from client
+ * memory and the camera is set as separate projection and view uniforms
+ * on each program. On a 3.3 core context nothing is drawn from client
+ * memory: the stream is written into a StreamBuffer ring, mapped
+ * persistently where the driver allows, and drawn through a vertex array
+ * of its own; every static mesh gets a buffer and a vertex array; and the
+ * camera is one premultiplied view-projection matrix in a uniform buffer
+ * that every program's Camera block reads from CAMERA_BINDING. Animated
+ * sprites are worked out by the shader there, from the SpriteAnimation
+ * table in a second uniform buffer at CLIPS_BINDING.
+ *
+ * Static mesh buffers are uploaded the first time the mesh is drawn and
+ * again only when its version changes; ones nobody has drawn for a while
+ * are freed. Needs the GL context current, destruction included.
+ *
+ * With materials enabled, each batch is pushed towards the viewer through
+ * its model matrix by its place in the frame's draw order, so depth
+ * testing with GL_LEQUAL reproduces the sorted order whatever order the
+ * batches are actually drawn in. That needs a depth buffer on every
+ * target and a projection that keeps model z from 0 to 1 inside the clip
+ * volume, as the game's orthographic one does.
+ *
+ * Indexed textures are drawn through their palette, bound on PALETTE_UNIT,
+ * with the row each sprite asked for packed into its u coordinate (see
+ * RenderCommand).
+ */
+class RenderDevice {
+public:
+    static const GLuint CAMERA_BINDING = 0;
+    static const GLuint CLIPS_BINDING = 1;
+
+    // Fixed by layout qualifiers in the 330 shaders, so vertex arrays work with any program
+    static const GLuint POSITION_LOCATION = 0;
+    static const GLuint TEXCOORD_LOCATION = 1;
+
+    // Texture unit the palette of an indexed texture is bound to
+    static const GLint PALETTE_UNIT = 1;
+
+    // Overdraw view: each fragment written adds 1/OVERDRAW_LEVELS to every channel
+    static const int OVERDRAW_LEVELS = 8;
+
+    RenderDevice(bool coreProfile);
+    ~RenderDevice();
+
+    bool IsCoreProfile() const { return coreProfile; }
+    bool AnimatesOnGpu() const { return coreProfile; }
+
+    // Points a freshly loaded 330 program's uniform blocks at the device's buffers
+    static void BindUniformBlocks(ShaderProgram *program);
+
+    void SetCamera(ShaderProgram *program, const glm::mat4 &projection, const glm::mat4 &view);
+
+    // Core only: the clip table, uploaded when it has grown, and the
+    // animated sprite program's clock
+    void SetAnimation(ShaderProgram *program, const SpriteAnimation &clips, float time);
+
+    // Where batches get their material, by texture. Without a lookup, or
+    // with materials off, every batch is blended in sorted order with no
+    // depth test.
+    void SetMaterialLookup(Material (*lookup)(GLuint textureID)) { materialLookup = lookup; }
+    void EnableMaterials(bool enabled) { materialsEnabled = enabled; }
+    bool MaterialsEnabled() const { return materialsEnabled; }
+    Material MaterialOf(GLuint textureID) const;
+
+    // Where indexed textures get their palette and its row count; 0 for a
+    // texture that holds its colours directly
+    void SetPaletteLookup(GLuint (*lookup)(GLuint textureID, int *rows)) { paletteLookup = lookup; }
+
+    // Told about every texture a batch is drawn with, for residency
+    // tracking. Returning false skips the batch: its texture is not all
+    // there yet.
+    void SetTextureUse(bool (*use)(GLuint textureID)) { textureUse = use; }
+
+    // Threads RenderQueue::Execute may write the vertex stream on; NULL
+    // writes it on the calling thread
+    void SetWorkers(ThreadPool *pool) { workers = pool; }
+    ThreadPool *Workers() const { return workers; }
+
+    void SetOverdrawView(bool enabled) { overdraw = enabled; }
+    bool OverdrawView() const { return overdraw; }
+
+    // Called by RenderQueue::Execute, possibly several times a frame.
+    // BeginDraws() returns room for the stream, to be filled before the
+    // first Draw(). Draw() takes the batch's index in the sorted order.
+    // EndDraws() leaves premultiplied blending on and depth testing off.
+    float *BeginDraws(int streamVertices);
+    void BeginMaterial(Material material);
+    void UseProgram(ShaderProgram *program);
+    void Draw(const RenderBatch &batch, int order);
+    void EndDraws();
+
+    // Once per frame, after its last Execute
+    void EndFrame();
+
+    int MeshUploads() const { return meshUploads; }
+    int StreamStalls() const { return streamRing != NULL ? streamRing->Stalls() : 0; }
+
+private:
+    struct MeshEntry {
+        GLuint buffer;
+        GLuint vertexArray;   // 0 on a legacy context
+        uint32_t version;
+        int lastUsed;
+    };
+
+    MeshEntry &Upload(const StaticMesh &mesh);
+    void BindVertices(const StaticMesh *mesh);   // NULL for the frame's stream
+    void PointAttributes(GLuint position, GLuint texCoord, const float *base);
+    void ReleaseProgram();
+    bool DepthOrdered() const { return materialsEnabled && materialLookup != NULL; }
+
+    bool coreProfile;
+
+    GLuint cameraBuffer = 0;
+    GLuint clipsBuffer = 0;
+    int uploadedClips = 0;
+    StreamBuffer *streamRing = NULL;
+    GLuint streamArray = 0;
+    int streamArrayGeneration = 0;  // of the ring buffer streamArray points at; 0 for none yet
+    int streamFirstVertex = 0;      // where this frame's region starts
+    bool streamOpen = false;        // written but not yet handed to GL
+
+    std::vector<float> stream;      // legacy client array
+    ShaderProgram *program = NULL;
+    const StaticMesh *source = NULL;
+    bool sourceBound = false;
+
+    Material (*materialLookup)(GLuint textureID) = NULL;
+    bool materialsEnabled = true;
+    bool overdraw = false;
+    GLuint (*paletteLookup)(GLuint textureID, int *rows) = NULL;
+    bool (*textureUse)(GLuint textureID) = NULL;
+    ThreadPool *workers = NULL;
+    Material material = MATERIAL_TRANSLUCENT;
+    int orderBase = 0;   // depth orders used by earlier Executes this frame
+    int orderUsed = 0;
+
+    std::unordered_map<uint64_t, MeshEntry> meshes;
+    int frame = 0;
+    int meshUploads = 0;
+};
+
+#endif /* RenderDevice_h */
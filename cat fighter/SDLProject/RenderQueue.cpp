@@ -0,0 +1,425 @@
+//
+//  RenderQueue.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+
+#include <algorithm>
+#include "RenderQueue.h"
+#include "GpuProfiler.h"
+#include "RenderDevice.h"
+#include "ShaderProgram.h"
+#include "SpriteAnimation.h"
+#include "ThreadPool.h"
+
+const int LAYER_SHIFT   = 56;
+const int SHADER_SHIFT  = 48;
+const int TEXTURE_SHIFT = 24;
+
+const uint64_t SHADER_MASK  = 0xFF;
+const uint64_t TEXTURE_MASK = 0xFFFFFF;
+const uint64_t DEPTH_MASK   = 0xFFFFFF;
+
+const int VERTICES_PER_QUAD = 6;
+const float IDENTITY_TRANSFORM[6] = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+const int MIN_COMMANDS_PER_SLICE = 512;   // fewer are written on one thread, not worth handing out
+
+void RenderQueue::Clear()
+{
+    commands.clear();
+    arena.clear();
+    meshes.clear();
+    order.clear();
+}
+
+uint64_t RenderQueue::MakeKey(RenderLayer layer, ShaderProgram *program, GLuint textureID, float depth)
+{
+    // Programs get a small id the first time they are seen
+    uint64_t shader = std::find(programs.begin(), programs.end(), program) - programs.begin();
+    if (shader == programs.size()) programs.push_back(program);
+
+    // Depth 0 is the back of the layer
+    float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+    uint64_t quantised = (uint64_t) (clamped * DEPTH_MASK);
+
+    return ((uint64_t) layer << LAYER_SHIFT)
+         | ((shader & SHADER_MASK) << SHADER_SHIFT)
+         | (((uint64_t) textureID & TEXTURE_MASK) << TEXTURE_SHIFT)
+         | (quantised & DEPTH_MASK);
+}
+
+// Only the 2D part of a model matrix matters for sprites
+static void matrix_transform(const glm::mat4 &modelMatrix, float transform[6])
+{
+    transform[0] = modelMatrix[0][0];
+    transform[1] = modelMatrix[0][1];
+    transform[2] = modelMatrix[1][0];
+    transform[3] = modelMatrix[1][1];
+    transform[4] = modelMatrix[3][0];
+    transform[5] = modelMatrix[3][1];
+}
+
+RenderCommand &RenderQueue::NewCommand(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const float transform[6])
+{
+    commands.emplace_back();
+    RenderCommand &command = commands.back();
+
+    command.sortKey = MakeKey(layer, program, textureID, depth);
+    command.program = program;
+    command.textureID = textureID;
+    command.mesh = -1;
+    command.clip = -1;
+    command.phase = 0;
+    std::copy(transform, transform + 6, command.transform);
+
+    return command;
+}
+
+void RenderQueue::SubmitQuad(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const glm::mat4 &modelMatrix,
+                             const float rect[4], const float uv[4])
+{
+    float transform[6];
+    matrix_transform(modelMatrix, transform);
+    SubmitQuad(layer, depth, program, textureID, transform, rect, uv);
+}
+
+void RenderQueue::SubmitQuad(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const Transform2D &transform,
+                             const float rect[4], const float uv[4])
+{
+    float affine[6];
+    transform.ToAffine(affine);
+    SubmitQuad(layer, depth, program, textureID, affine, rect, uv);
+}
+
+void RenderQueue::SubmitQuad(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const float transform[6],
+                             const float rect[4], const float uv[4])
+{
+    RenderCommand &command = NewCommand(layer, depth, program, textureID, transform);
+    std::copy(rect, rect + 4, command.rect);
+    std::copy(uv, uv + 4, command.uv);
+    command.firstVertex = -1;
+    command.vertexCount = VERTICES_PER_QUAD;
+}
+
+float *RenderQueue::AllocateVertices(int count, int *firstVertex)
+{
+    *firstVertex = (int) arena.size() / FLOATS_PER_VERTEX;
+    arena.resize(arena.size() + count * FLOATS_PER_VERTEX);
+    return &arena[*firstVertex * FLOATS_PER_VERTEX];
+}
+
+void RenderQueue::SubmitVertices(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const glm::mat4 &modelMatrix,
+                                 int firstVertex, int vertexCount)
+{
+    float transform[6];
+    matrix_transform(modelMatrix, transform);
+    RenderCommand &command = NewCommand(layer, depth, program, textureID, transform);
+    command.firstVertex = firstVertex;
+    command.vertexCount = vertexCount;
+}
+
+void RenderQueue::SubmitMesh(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, std::shared_ptr<const StaticMesh> mesh)
+{
+    // Mesh vertices are already in world space
+    RenderCommand &command = NewCommand(layer, depth, program, textureID, IDENTITY_TRANSFORM);
+    command.firstVertex = 0;
+    command.vertexCount = (int) mesh->vertices.size() / FLOATS_PER_VERTEX;
+    command.mesh = (int) meshes.size();
+    meshes.push_back(std::move(mesh));
+}
+
+void RenderQueue::SetAnimation(const SpriteAnimation *clips, float time)
+{
+    animation = clips;
+    animationTime = time;
+}
+
+void RenderQueue::SubmitAnimated(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const glm::mat4 &modelMatrix,
+                                 const float rect[4], int clip, int phase)
+{
+    float transform[6];
+    matrix_transform(modelMatrix, transform);
+    SubmitAnimated(layer, depth, program, textureID, transform, rect, clip, phase);
+}
+
+void RenderQueue::SubmitAnimated(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const Transform2D &transform,
+                                 const float rect[4], int clip, int phase)
+{
+    float affine[6];
+    transform.ToAffine(affine);
+    SubmitAnimated(layer, depth, program, textureID, affine, rect, clip, phase);
+}
+
+void RenderQueue::SubmitAnimated(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const float transform[6],
+                                 const float rect[4], int clip, int phase)
+{
+    RenderCommand &command = NewCommand(layer, depth, program, textureID, transform);
+    std::copy(rect, rect + 4, command.rect);
+    command.firstVertex = -1;
+    command.vertexCount = VERTICES_PER_QUAD;
+    command.clip = clip;
+    command.phase = phase;
+}
+
+void RenderQueue::Sort()
+{
+    order.resize(commands.size());
+    scratch.resize(commands.size());
+    for (uint32_t i = 0; i < commands.size(); i++) order[i] = { commands[i].sortKey, i };
+
+    // LSD radix sort, one byte per pass. It is stable, so commands with equal
+    // keys keep their submission order. A pass where every key has the same
+    // byte would not move anything and is skipped.
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = { 0 };
+        for (const SortEntry &entry : order) counts[(entry.key >> shift) & 0xFF]++;
+
+        if (counts[(order.empty() ? 0 : (order[0].key >> shift) & 0xFF)] == order.size()) continue;
+
+        size_t offsets[256];
+        size_t total = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            offsets[bucket] = total;
+            total += counts[bucket];
+        }
+
+        for (const SortEntry &entry : order) scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+        order.swap(scratch);
+    }
+}
+
+static RenderLayer command_layer(const RenderCommand &command)
+{
+    return (RenderLayer) (command.sortKey >> LAYER_SHIFT);
+}
+
+int RenderQueue::StreamVertexCount(RenderLayer first, RenderLayer last) const
+{
+    int count = 0;
+    for (const RenderCommand &command : commands)
+    {
+        RenderLayer layer = command_layer(command);
+        if (command.mesh < 0 && layer >= first && layer <= last) count += command.vertexCount;
+    }
+    return count;
+}
+
+// FNV-1a, 64 bit
+static void hash_bytes(uint64_t &hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+}
+
+uint64_t RenderQueue::LayerSignature(RenderLayer first, RenderLayer last) const
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (const RenderCommand &command : commands)
+    {
+        RenderLayer layer = command_layer(command);
+        if (layer < first || layer > last) continue;
+
+        hash_bytes(hash, &command.sortKey, sizeof(command.sortKey));
+        hash_bytes(hash, command.transform, sizeof(command.transform));
+        hash_bytes(hash, &command.vertexCount, sizeof(command.vertexCount));
+
+        if (command.mesh >= 0)
+        {
+            // A mesh is only ever replaced by a higher version, never edited
+            hash_bytes(hash, &meshes[command.mesh]->id, sizeof(uint64_t));
+            hash_bytes(hash, &meshes[command.mesh]->version, sizeof(uint32_t));
+        }
+        else if (command.firstVertex >= 0)
+        {
+            hash_bytes(hash, &arena[command.firstVertex * FLOATS_PER_VERTEX], command.vertexCount * FLOATS_PER_VERTEX * sizeof(float));
+        }
+        else
+        {
+            hash_bytes(hash, command.rect, sizeof(command.rect));
+            hash_bytes(hash, command.uv, sizeof(command.uv));
+            if (command.clip >= 0)
+            {
+                float uv[4];
+                animation->FrameUV(command.clip, animationTime, command.phase, uv);
+                hash_bytes(hash, uv, sizeof(uv));
+            }
+        }
+    }
+
+    return hash;
+}
+
+void RenderQueue::Prepare(ThreadPool *workers)
+{
+    frameVertices.resize(StreamVertexCount(LAYER_BACKGROUND, LAYER_UI) * FLOATS_PER_VERTEX);
+    BuildBatches(frameVertices.data(), false, LAYER_BACKGROUND, LAYER_UI, workers);
+}
+
+void RenderQueue::BuildBatches(float *stream, bool animateOnGpu, RenderLayer first, RenderLayer last, ThreadPool *workers)
+{
+    // Layout: which commands go into the stream, in order, and where each
+    // one's vertices start. Cheap next to writing them.
+    int vertexCount = 0;
+    streamCommands.clear();
+    streamOffsets.clear();
+    batches.clear();
+
+    for (const SortEntry &entry : order)
+    {
+        const RenderCommand &command = commands[entry.index];
+        RenderLayer layer = command_layer(command);
+        if (layer < first || layer > last) continue;
+
+        // A static mesh is a batch of its own, drawn from its buffer object
+        if (command.mesh >= 0)
+        {
+            batches.push_back({ layer, command.program, command.textureID, 0, command.vertexCount, meshes[command.mesh].get(), MATERIAL_TRANSLUCENT });
+            continue;
+        }
+
+        // Batches never straddle layers, so each layer can be timed on its own
+        if (batches.empty() || batches.back().mesh != NULL || batches.back().layer != layer
+            || batches.back().program != command.program || batches.back().textureID != command.textureID)
+        {
+            batches.push_back({ layer, command.program, command.textureID, vertexCount, 0, NULL, MATERIAL_TRANSLUCENT });
+        }
+
+        streamCommands.push_back(entry.index);
+        streamOffsets.push_back(vertexCount);
+        vertexCount += command.vertexCount;
+        batches.back().vertexCount += command.vertexCount;
+    }
+
+    // Then the vertices, in slices of whole commands; each slice fills its
+    // own region of the stream, so they need no locking
+    int total = (int) streamCommands.size();
+    int slices = workers != NULL ? std::min(workers->ThreadCount() + 1, total / MIN_COMMANDS_PER_SLICE) : 1;
+    if (slices <= 1)
+    {
+        EmitVertices(stream, 0, total, animateOnGpu);
+    }
+    else
+    {
+        // The calling thread takes the last slice instead of waiting idle
+        for (int slice = 0; slice < slices - 1; slice++)
+        {
+            int begin = total * slice / slices, end = total * (slice + 1) / slices;
+            workers->Submit([this, stream, begin, end, animateOnGpu] { EmitVertices(stream, begin, end, animateOnGpu); });
+        }
+        EmitVertices(stream, total * (slices - 1) / slices, total, animateOnGpu);
+        workers->Wait();
+    }
+
+    stats.commands = (int) commands.size();
+    stats.batches  = (int) batches.size();
+    stats.vertices = 0;
+    for (const RenderBatch &batch : batches) stats.vertices += batch.vertexCount;
+}
+
+void RenderQueue::EmitVertices(float *stream, int begin, int end, bool animateOnGpu) const
+{
+    if (begin == end) return;
+
+    // Only ever written forwards: `stream` may be write-combined GPU memory
+    float *out = stream + streamOffsets[begin] * FLOATS_PER_VERTEX;
+
+    for (int i = begin; i < end; i++)
+    {
+        const RenderCommand &command = commands[streamCommands[i]];
+
+        const float *t = command.transform;
+        auto emit = [&out, t](float x, float y, float u, float v) {
+            out[0] = t[0] * x + t[2] * y + t[4];
+            out[1] = t[1] * x + t[3] * y + t[5];
+            out[2] = u;
+            out[3] = v;
+            out += FLOATS_PER_VERTEX;
+        };
+
+        if (command.firstVertex < 0)
+        {
+            const float *r = command.rect, *uv = command.uv;
+
+            // For the shader, the integer part of each corner's UV carries the clip and phase
+            float animated[4];
+            if (command.clip >= 0 && animateOnGpu)
+            {
+                animated[0] = 2.0f * command.clip;
+                animated[1] = 2.0f * command.phase;
+                animated[2] = animated[0] + 1.0f;
+                animated[3] = animated[1] + 1.0f;
+                uv = animated;
+            }
+            else if (command.clip >= 0)
+            {
+                animation->FrameUV(command.clip, animationTime, command.phase, animated);
+                uv = animated;
+            }
+
+            emit(r[0], r[1], uv[0], uv[3]);
+            emit(r[2], r[1], uv[2], uv[3]);
+            emit(r[2], r[3], uv[2], uv[1]);
+            emit(r[0], r[1], uv[0], uv[3]);
+            emit(r[2], r[3], uv[2], uv[1]);
+            emit(r[0], r[3], uv[0], uv[1]);
+        }
+        else
+        {
+            const float *vertex = &arena[command.firstVertex * FLOATS_PER_VERTEX];
+            for (int v = 0; v < command.vertexCount; v++, vertex += FLOATS_PER_VERTEX)
+            {
+                emit(vertex[0], vertex[1], vertex[2], vertex[3]);
+            }
+        }
+    }
+}
+
+void RenderQueue::Execute(RenderDevice &device, GpuProfiler *profiler, RenderLayer first, RenderLayer last)
+{
+    // The stream is built straight into whatever memory the device draws it from
+    BuildBatches(device.BeginDraws(StreamVertexCount(first, last)), device.AnimatesOnGpu(), first, last, device.Workers());
+    for (RenderBatch &batch : batches) batch.material = device.MaterialOf(batch.textureID);
+
+    int timedLayer = -1;
+    int count = (int) batches.size();
+
+    for (int material = MATERIAL_OPAQUE; material <= MATERIAL_TRANSLUCENT; material++)
+    {
+        ShaderProgram *bound = NULL;
+        bool frontToBack = material != MATERIAL_TRANSLUCENT;
+
+        for (int i = 0; i < count; i++)
+        {
+            int order = frontToBack ? count - 1 - i : i;
+            const RenderBatch &batch = batches[order];
+            if (batch.material != material) continue;
+
+            if (bound == NULL) device.BeginMaterial((Material) material);
+
+            // Starting a pass ends the one before it; a layer can be timed in
+            // several pieces, one per material
+            if (profiler != NULL && batch.layer != timedLayer)
+            {
+                profiler->BeginPass(batch.layer);
+                timedLayer = batch.layer;
+            }
+
+            if (batch.program != bound)
+            {
+                device.UseProgram(batch.program);
+                bound = batch.program;
+            }
+
+            device.Draw(batch, order);
+        }
+    }
+
+    device.EndDraws();
+    if (profiler != NULL) profiler->EndPass();
+}
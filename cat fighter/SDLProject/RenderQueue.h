@@ -0,0 +1,214 @@
+//
+//  RenderQueue.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef RenderQueue_h
+#define RenderQueue_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "Transform2D.h"
+
+class ShaderProgram;
+class GpuProfiler;
+class RenderDevice;
+class SpriteAnimation;
+class ThreadPool;
+
+/**
+ * Coarse draw order. Layers are the top bits of every sort key, so
+ * everything in one layer is drawn before anything in the next.
+ */
+enum RenderLayer { LAYER_BACKGROUND = 0, LAYER_WORLD = 1, LAYER_ACTORS = 2, LAYER_UI = 3 };
+
+/**
+ * How a texture's pixels cover what is behind them, known once it has
+ * loaded. Opaque textures are drawn without blending, cutout ones without
+ * blending and with their transparent texels discarded, and anything else
+ * is blended. Also the order they are drawn in within an Execute().
+ */
+enum Material { MATERIAL_OPAQUE = 0, MATERIAL_CUTOUT = 1, MATERIAL_TRANSLUCENT = 2 };
+
+/**
+ * Geometry that rarely changes, already in world space as x, y, u, v. Once
+ * built a mesh is never modified: a change produces a new mesh with the
+ * same id and a higher version, so the simulation can hand one to the
+ * render thread without copying or locking.
+ */
+struct StaticMesh {
+    uint64_t id;
+    uint32_t version;
+    std::vector<float> vertices;
+};
+
+/**
+ * One draw, as small as we can keep it. Sprites are a quad (corners + UV
+ * rectangle) under a 2D affine transform; anything else, like a line of
+ * text, points at a run of vertices in the queue's vertex arena, and static
+ * geometry points at a StaticMesh. An animated sprite is a quad whose UV
+ * rectangle comes from its clip at draw time.
+ *
+ * Sort key, most significant first:
+ *
+ *     | layer : 8 | shader : 8 | texture : 24 | depth : 24 |
+ */
+struct RenderCommand {
+    uint64_t sortKey;
+    ShaderProgram *program;
+    GLuint textureID;
+
+    float transform[6];   // x' = a*x + c*y + tx, y' = b*x + d*y + ty, stored as a, b, c, d, tx, ty
+    float rect[4];        // quad corners in local space: x0, y0, x1, y1
+    float uv[4];          // u0, v0 (top left of the image), u1, v1; u is 2 * palette row + u
+
+    int firstVertex;      // -1 for a quad
+    int vertexCount;
+    int mesh;             // index into the queue's meshes, or -1
+    int clip;             // SpriteAnimation clip, or -1
+    int phase;
+};
+
+/**
+ * A run of vertices in the prepared stream that share a layer, shader and
+ * texture, or a whole static mesh.
+ */
+struct RenderBatch {
+    RenderLayer layer;
+    ShaderProgram *program;
+    GLuint textureID;
+    int firstVertex;
+    int vertexCount;
+    const StaticMesh *mesh;   // NULL for the stream
+    Material material;        // set by Execute(); always translucent from Prepare()
+};
+
+struct RenderStats {
+    int commands = 0;
+    int batches = 0;
+    int vertices = 0;
+};
+
+/**
+ * Collects a frame's draws, radix-sorts them by key once and then issues
+ * them in key order. Consecutive commands sharing a shader and texture are
+ * merged into a single glDrawArrays, with vertices transformed on the CPU
+ * into one interleaved stream (x, y, u, v). Static meshes skip all of that
+ * and are drawn straight from their buffer objects.
+ *
+ * Every command's place in the stream is worked out before any vertex is
+ * written, so with thousands of sprites the writing can be split across
+ * worker threads, each filling a region of its own.
+ */
+class RenderQueue {
+public:
+    static const int FLOATS_PER_VERTEX = 4;
+
+    void Clear();
+
+    void SubmitQuad(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const glm::mat4 &modelMatrix,
+                    const float rect[4], const float uv[4]);
+    void SubmitQuad(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const Transform2D &transform,
+                    const float rect[4], const float uv[4]);
+
+    // Space for `count` local-space vertices; fill it before the next call
+    float *AllocateVertices(int count, int *firstVertex);
+    void SubmitVertices(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const glm::mat4 &modelMatrix,
+                        int firstVertex, int vertexCount);
+
+    // The queue keeps the mesh alive until the next Clear()
+    void SubmitMesh(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, std::shared_ptr<const StaticMesh> mesh);
+
+    // Clips and clock for animated sprites; the clips must outlive the queue
+    void SetAnimation(const SpriteAnimation *clips, float time);
+    float AnimationTime() const { return animationTime; }
+
+    // `program` has to be the animated sprite shader when the device animates on the GPU
+    void SubmitAnimated(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const glm::mat4 &modelMatrix,
+                        const float rect[4], int clip, int phase);
+    void SubmitAnimated(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const Transform2D &transform,
+                        const float rect[4], int clip, int phase);
+
+    void Sort();
+
+    // Merges the sorted commands into batches over one world-space vertex
+    // stream kept in the queue. Needs no GL, so the software renderer draws
+    // from it as well. Given workers, big streams are written in slices
+    // across them.
+    void Prepare(ThreadPool *workers = NULL);
+    const std::vector<RenderBatch> &Batches() const { return batches; }
+    const std::vector<float> &Vertices() const { return frameVertices; }
+
+    // Builds the batches with the stream written into memory the device
+    // hands out, then one draw per batch, for the layers from `first` to
+    // `last` only. With a profiler, each layer is timed as the pass of the
+    // same index. Vertices() is not filled. Animated sprites are left to
+    // the shader if the device can do that. The stream is written across
+    // the device's workers, if it has any; every GL call stays on the
+    // calling thread.
+    //
+    // With materials on, opaque and then cutout batches go first, front to
+    // back, each at a depth given by its place in the sorted order; blended
+    // batches follow back to front. Anything hidden behind an opaque pixel
+    // fails the depth test instead of being shaded and blended, and the
+    // image is the same as drawing every batch in order.
+    void Execute(RenderDevice &device, GpuProfiler *profiler = NULL,
+                 RenderLayer first = LAYER_BACKGROUND, RenderLayer last = LAYER_UI);
+
+    // Changes whenever anything drawn in the given layers would look different
+    uint64_t LayerSignature(RenderLayer first, RenderLayer last) const;
+
+    const RenderStats &Stats() const { return stats; }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    int StreamVertexCount(RenderLayer first, RenderLayer last) const;
+    void BuildBatches(float *stream, bool animateOnGpu, RenderLayer first, RenderLayer last, ThreadPool *workers);
+    void EmitVertices(float *stream, int begin, int end, bool animateOnGpu) const;
+
+    uint64_t MakeKey(RenderLayer layer, ShaderProgram *program, GLuint textureID, float depth);
+    RenderCommand &NewCommand(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const float transform[6]);
+
+    // What every Submit comes down to, with the transform already in RenderCommand's form
+    void SubmitQuad(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const float transform[6],
+                    const float rect[4], const float uv[4]);
+    void SubmitAnimated(RenderLayer layer, float depth, ShaderProgram *program, GLuint textureID, const float transform[6],
+                        const float rect[4], int clip, int phase);
+
+    std::vector<RenderCommand> commands;
+    std::vector<float> arena;
+    std::vector<std::shared_ptr<const StaticMesh>> meshes;
+
+    const SpriteAnimation *animation = NULL;
+    float animationTime = 0.0f;
+
+    std::vector<SortEntry> order;
+    std::vector<SortEntry> scratch;
+
+    std::vector<ShaderProgram*> programs;   // shader ids for sort keys
+
+    std::vector<float> frameVertices;
+    std::vector<RenderBatch> batches;
+
+    // Commands in the stream, in order, and the vertex each one starts at
+    std::vector<uint32_t> streamCommands;
+    std::vector<int> streamOffsets;
+
+    RenderStats stats;
+};
+
+#endif /* RenderQueue_h */
@@ -0,0 +1,46 @@
+//
+//  ResolutionScaler.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include "ResolutionScaler.h"
+
+const double HEADROOM = 0.8;    // of the budget a level up has to fit in
+const double SMOOTHING = 0.2;   // weight of the newest frame
+
+ResolutionScaler::ResolutionScaler(double budgetMilliseconds) : budget(budgetMilliseconds)
+{
+}
+
+bool ResolutionScaler::AddFrame(double milliseconds)
+{
+    framesAtLevel[level]++;
+
+    smoothed = measured ? smoothed + (milliseconds - smoothed) * SMOOTHING : milliseconds;
+    measured = true;
+
+    if (settling > 0)
+    {
+        settling--;
+        return false;
+    }
+
+    overBudget = smoothed > budget ? overBudget + 1 : 0;
+
+    float up = level > 0 ? LevelScale(level - 1) / Scale() : 1.0f;
+    underBudget = level > 0 && smoothed * up * up < budget * HEADROOM ? underBudget + 1 : 0;
+
+    int next = level;
+    if (overBudget >= DOWN_FRAMES && level < LEVELS - 1) next = level + 1;
+    else if (underBudget >= UP_FRAMES) next = level - 1;
+    if (next == level) return false;
+
+    level = next;
+    overBudget = 0;
+    underBudget = 0;
+    settling = SETTLE_FRAMES;
+    changes++;
+    return true;
+}
@@ -0,0 +1,60 @@
+//
+//  ResolutionScaler.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef ResolutionScaler_h
+#define ResolutionScaler_h
+
+/**
+ * Picks the resolution the world is drawn at from measured frame times.
+ *
+ * Scales come in LEVELS steps of an eighth, from 1 down to 1/2. Frame times
+ * are smoothed, and the scale only drops a level after DOWN_FRAMES frames
+ * in a row over budget, and only rises one after UP_FRAMES frames in a row
+ * in which the level above would still come in under HEADROOM of the
+ * budget, taking fill cost to grow with the square of the scale. After any
+ * change nothing is judged for SETTLE_FRAMES, so the frames measured are
+ * ones drawn at the new scale. The gap between the two thresholds and the
+ * two frame counts keeps it from flickering between neighbouring levels.
+ *
+ * Touches no GL; feed it whatever frame time is being governed.
+ */
+class ResolutionScaler {
+public:
+    static const int LEVELS = 5;
+    static const int DOWN_FRAMES = 4;
+    static const int UP_FRAMES = 90;
+    static const int SETTLE_FRAMES = 8;
+
+    ResolutionScaler(double budgetMilliseconds);
+
+    // True if the frame moved the scale
+    bool AddFrame(double milliseconds);
+
+    float Scale() const { return LevelScale(level); }
+    static float LevelScale(int level) { return 1.0f - level / 8.0f; }
+
+    double BudgetMilliseconds() const { return budget; }
+    double SmoothedMilliseconds() const { return smoothed; }
+
+    int Changes() const { return changes; }
+    int FramesAtLevel(int level) const { return framesAtLevel[level]; }
+
+private:
+    double budget;
+    double smoothed = 0;
+    bool measured = false;
+
+    int level = 0;
+    int overBudget = 0;    // frames in a row
+    int underBudget = 0;
+    int settling = 0;
+
+    int changes = 0;
+    int framesAtLevel[LEVELS] = {};
+};
+
+#endif /* ResolutionScaler_h */
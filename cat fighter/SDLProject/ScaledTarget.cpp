@@ -0,0 +1,77 @@
+//
+//  ScaledTarget.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+#define LOG(argument) std::cout << argument << '\n'
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "ScaledTarget.h"
+#include "RenderDevice.h"
+
+ScaledTarget::ScaledTarget(int width, int height) : width(width), height(height), scaledWidth(width), scaledHeight(height)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    complete = status == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete) LOG("Scaled framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ").");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ScaledTarget::~ScaledTarget()
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthbuffer);
+    glDeleteTextures(1, &texture);
+}
+
+void ScaledTarget::SetScale(float next)
+{
+    scale = std::min(std::max(next, 0.0f), 1.0f);
+    scaledWidth = std::max(1, (int) std::lround(width * scale));
+    scaledHeight = std::max(1, (int) std::lround(height * scale));
+}
+
+void ScaledTarget::Bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, scaledWidth, scaledHeight);
+}
+
+void ScaledTarget::Present(RenderDevice &device, ShaderProgram *program, const Bounds2D &view)
+{
+    // Only the drawn corner of the texture; rows run bottom up
+    float u = (float) scaledWidth / width;
+    float v = (float) scaledHeight / height;
+    const float rect[] = { view.left, view.bottom, view.right, view.top };
+    const float uv[] = { 0.0f, v, u, 0.0f };
+
+    presentQueue.Clear();
+    presentQueue.SubmitQuad(LAYER_BACKGROUND, 0.0f, program, texture, glm::mat4(1.0f), rect, uv);
+    presentQueue.Sort();
+    presentQueue.Execute(device);
+}
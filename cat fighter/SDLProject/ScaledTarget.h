@@ -0,0 +1,65 @@
+//
+//  ScaledTarget.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef ScaledTarget_h
+#define ScaledTarget_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include "Culling.h"
+#include "RenderQueue.h"
+
+class RenderDevice;
+
+/**
+ * Somewhere to draw at less than full resolution: a colour texture and
+ * depth buffer the size of the screen, of which only the bottom left
+ * Scale() of each side is drawn into. Present() stretches that part over
+ * whatever is bound with one quad, sampled nearest so sprites stay sharp.
+ * Changing the scale reallocates nothing.
+ *
+ * Needs the GL context current, destruction included.
+ */
+class ScaledTarget {
+public:
+    ScaledTarget(int width, int height);
+    ~ScaledTarget();
+
+    bool IsComplete() const { return complete; }
+
+    void SetScale(float scale);
+    float Scale() const { return scale; }
+    int ScaledWidth() const { return scaledWidth; }
+    int ScaledHeight() const { return scaledHeight; }
+
+    // Binds the framebuffer with the viewport over the scaled part
+    void Bind();
+
+    // `view` is the world area the frame's camera shows
+    void Present(RenderDevice &device, ShaderProgram *program, const Bounds2D &view);
+
+private:
+    int width;
+    int height;
+    bool complete = false;
+
+    GLuint framebuffer = 0;
+    GLuint texture = 0;
+    GLuint depthbuffer = 0;
+
+    float scale = 1.0f;
+    int scaledWidth;
+    int scaledHeight;
+
+    RenderQueue presentQueue;
+};
+
+#endif /* ScaledTarget_h */
@@ -25,6 +25,10 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
     projectionMatrixUniform = glGetUniformLocation(programID, "projectionMatrix");
     viewMatrixUniform = glGetUniformLocation(programID, "viewMatrix");
 	colorUniform = glGetUniformLocation(programID, "color");
+    alphaCutoffUniform = glGetUniformLocation(programID, "alphaCutoff");
+    overdrawUniform = glGetUniformLocation(programID, "overdraw");
+    paletteUniform = glGetUniformLocation(programID, "palette");
+    paletteRowsUniform = glGetUniformLocation(programID, "paletteRows");
     
     positionAttribute = glGetAttribLocation(programID, "position");
     texCoordAttribute = glGetAttribLocation(programID, "texCoord");
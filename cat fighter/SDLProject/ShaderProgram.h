@@ -32,6 +32,10 @@ class ShaderProgram {
         GLuint modelMatrixUniform;
         GLuint viewMatrixUniform;
 		GLuint colorUniform;
+        GLuint alphaCutoffUniform;
+        GLuint overdrawUniform;
+        GLuint paletteUniform;
+        GLuint paletteRowsUniform;
 	
         GLuint positionAttribute;
         GLuint texCoordAttribute;
@@ -0,0 +1,393 @@
+//
+//  SoftwareRenderer.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "SoftwareRenderer.h"
+#include "CookedTexture.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFTWARE_RENDERER_SSE2 1
+#endif
+
+/**
+ * x / 255, rounded, for x up to 255 * 255.
+ */
+static inline uint32_t div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static uint32_t pack_rgba(const unsigned char rgba[4])
+{
+    uint32_t pixel;
+    memcpy(&pixel, rgba, 4);
+    return pixel;
+}
+
+/**
+ * Premultiplied "over", the same as glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA),
+ * for the four pixels at dst whose mask is all ones. The rest are left alone.
+ */
+static inline void blend4(uint32_t *dst, const uint32_t src[4], const uint32_t mask[4])
+{
+#ifdef SOFTWARE_RENDERER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(128);
+
+    __m128i source = _mm_loadu_si128((const __m128i*) src);
+    __m128i destination = _mm_loadu_si128((const __m128i*) dst);
+    __m128i inverse = _mm_sub_epi8(_mm_set1_epi8((char) 0xFF), source);
+
+    // Two pixels per half, widened to 16 bits, with 255 - alpha in every channel
+    __m128i low = _mm_unpacklo_epi8(destination, zero);
+    __m128i high = _mm_unpackhi_epi8(destination, zero);
+    __m128i inverseLow = _mm_unpacklo_epi8(inverse, zero);
+    __m128i inverseHigh = _mm_unpackhi_epi8(inverse, zero);
+    inverseLow = _mm_shufflehi_epi16(_mm_shufflelo_epi16(inverseLow, 0xFF), 0xFF);
+    inverseHigh = _mm_shufflehi_epi16(_mm_shufflelo_epi16(inverseHigh, 0xFF), 0xFF);
+
+    low = _mm_add_epi16(_mm_mullo_epi16(low, inverseLow), round);
+    high = _mm_add_epi16(_mm_mullo_epi16(high, inverseHigh), round);
+    low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+    __m128i blended = _mm_adds_epu8(source, _mm_packus_epi16(low, high));
+
+    __m128i select = _mm_loadu_si128((const __m128i*) mask);
+    _mm_storeu_si128((__m128i*) dst, _mm_or_si128(_mm_and_si128(select, blended), _mm_andnot_si128(select, destination)));
+#else
+    for (int i = 0; i < 4; i++)
+    {
+        if (mask[i] == 0) continue;
+
+        unsigned char source[4], destination[4];
+        memcpy(source, &src[i], 4);
+        memcpy(destination, &dst[i], 4);
+
+        uint32_t inverse = 255 - source[3];
+        for (int channel = 0; channel < 4; channel++)
+        {
+            destination[channel] = (unsigned char) std::min<uint32_t>(255, source[channel] + div255(destination[channel] * inverse));
+        }
+        memcpy(&dst[i], destination, 4);
+    }
+#endif
+}
+
+/**
+ * Nearest texel along one axis of `size` texels, repeating or clamped. The
+ * SSE2 version below does the same float operations in the same order, so
+ * both paths pick the same texels.
+ */
+static inline int texel_coordinate(float coordinate, int size, bool clamp)
+{
+    float position;
+    if (clamp) position = std::max(coordinate * size, 0.0f);
+    else       position = (coordinate - std::floor(coordinate)) * size;
+
+    return (int) std::min(position, size - 1.0f);
+}
+
+#ifdef SOFTWARE_RENDERER_SSE2
+static inline __m128 floor4(__m128 x)
+{
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+static inline __m128i texel_coordinate4(__m128 coordinate, int size, bool clamp)
+{
+    __m128 scale = _mm_set1_ps((float) size);
+    __m128 position;
+    if (clamp) position = _mm_max_ps(_mm_mul_ps(coordinate, scale), _mm_setzero_ps());
+    else       position = _mm_mul_ps(_mm_sub_ps(coordinate, floor4(coordinate)), scale);
+
+    return _mm_cvttps_epi32(_mm_min_ps(position, _mm_set1_ps(size - 1.0f)));
+}
+#endif
+
+SoftwareRenderer::SoftwareRenderer(int width, int height, int threadCount) : width(width), height(height), pool(threadCount)
+{
+    stride = (width + 3) & ~3;
+    tilesAcross = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesDown = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    framebuffer.resize(stride * height);
+    bins.resize(tilesAcross * tilesDown);
+}
+
+void SoftwareRenderer::SetTexture(GLuint textureID, int width, int height, const unsigned char *pixels, bool clamp)
+{
+    if (textureID >= textures.size()) textures.resize(textureID + 1);
+
+    SoftwareTexture &texture = textures[textureID];
+    texture.width = width;
+    texture.height = height;
+    texture.paletteRows = 1;
+    texture.clamp = clamp;
+    texture.texels.resize(width * height);
+    memcpy(texture.texels.data(), pixels, width * height * 4);
+}
+
+void SoftwareRenderer::SetPalettedTexture(GLuint textureID, int width, int height, const unsigned char *indices,
+                                          const unsigned char *palette, int paletteRows, bool clamp)
+{
+    if (textureID >= textures.size()) textures.resize(textureID + 1);
+
+    SoftwareTexture &texture = textures[textureID];
+    texture.width = width;
+    texture.height = height;
+    texture.paletteRows = paletteRows;
+    texture.clamp = clamp;
+    texture.texels.resize(width * height * paletteRows);
+
+    for (int row = 0; row < paletteRows; row++)
+    {
+        const unsigned char *colors = palette + row * COOKED_PALETTE_SIZE * 4;
+        uint32_t *image = &texture.texels[row * width * height];
+        for (int i = 0; i < width * height; i++) memcpy(&image[i], &colors[indices[i] * 4], 4);
+    }
+}
+
+void SoftwareRenderer::SetClearColor(float red, float green, float blue, float alpha)
+{
+    const float channels[] = { red, green, blue, alpha };
+    unsigned char rgba[4];
+    for (int i = 0; i < 4; i++) rgba[i] = (unsigned char) std::lround(std::min(std::max(channels[i], 0.0f), 1.0f) * 255.0f);
+    clearColor = pack_rgba(rgba);
+}
+
+void SoftwareRenderer::Draw(RenderQueue &queue, const glm::mat4 &projection, const glm::mat4 &view)
+{
+    Setup(queue, projection, view);
+
+    for (int tileY = 0; tileY < tilesDown; tileY++)
+    {
+        for (int tileX = 0; tileX < tilesAcross; tileX++)
+        {
+            pool.Submit([this, tileX, tileY] { RasterizeTile(tileX, tileY); });
+        }
+    }
+    pool.Wait();
+}
+
+void SoftwareRenderer::Setup(RenderQueue &queue, const glm::mat4 &projection, const glm::mat4 &view)
+{
+    queue.Prepare(&pool);
+
+    triangles.clear();
+    for (std::vector<uint32_t> &bin : bins) bin.clear();
+
+    const glm::mat4 viewProjection = projection * view;
+    const std::vector<float> &vertices = queue.Vertices();
+
+    for (const RenderBatch &batch : queue.Batches())
+    {
+        // Textures still loading sample as transparent on the GL path too
+        if (batch.textureID >= textures.size() || textures[batch.textureID].width == 0) continue;
+        const SoftwareTexture *texture = &textures[batch.textureID];
+
+        // Static meshes carry their own vertices, already in world space too
+        const float *source = batch.mesh != NULL ? batch.mesh->vertices.data() : vertices.data();
+
+        for (int first = batch.firstVertex; first + 3 <= batch.firstVertex + batch.vertexCount; first += 3)
+        {
+            float corners[3][4];
+            for (int i = 0; i < 3; i++)
+            {
+                const float *vertex = &source[(first + i) * RenderQueue::FLOATS_PER_VERTEX];
+                glm::vec4 clip = viewProjection * glm::vec4(vertex[0], vertex[1], 0.0f, 1.0f);
+
+                // Pixel space, y down like the framebuffer rows
+                corners[i][0] = (clip.x / clip.w * 0.5f + 0.5f) * width;
+                corners[i][1] = (0.5f - clip.y / clip.w * 0.5f) * height;
+                corners[i][2] = vertex[2];
+                corners[i][3] = vertex[3];
+            }
+
+            // u carries the palette row as 2 * row + u, the same as in the shader;
+            // textures without that many rows show their own colours
+            int row = (int) std::floor(std::min(std::min(corners[0][2], corners[1][2]), corners[2][2]) * 0.5f);
+            for (int i = 0; i < 3; i++) corners[i][2] -= 2.0f * row;
+            row = std::min(std::max(row, 0), texture->paletteRows - 1);
+
+            AddTriangle(corners[0], corners[1], corners[2], texture, &texture->texels[row * texture->width * texture->height]);
+        }
+    }
+}
+
+void SoftwareRenderer::AddTriangle(const float *a, const float *b, const float *c, const SoftwareTexture *texture, const uint32_t *texels)
+{
+    auto edge = [](const float *from, const float *to, const float *point) {
+        return (point[0] - from[0]) * (to[1] - from[1]) - (point[1] - from[1]) * (to[0] - from[0]);
+    };
+
+    float area = edge(a, b, c);
+    if (area == 0) return;
+    if (area < 0)
+    {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    float minX = std::min(std::min(a[0], b[0]), c[0]), maxX = std::max(std::max(a[0], b[0]), c[0]);
+    float minY = std::min(std::min(a[1], b[1]), c[1]), maxY = std::max(std::max(a[1], b[1]), c[1]);
+
+    ScreenTriangle triangle;
+    triangle.minX = std::max(0, (int) std::floor(minX));
+    triangle.minY = std::max(0, (int) std::floor(minY));
+    triangle.maxX = std::min(width, (int) std::ceil(maxX));
+    triangle.maxY = std::min(height, (int) std::ceil(maxY));
+    if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY) return;
+
+    // Edge i is the one opposite vertex i, so its value is that vertex's weight
+    const float *points[3] = { a, b, c };
+    for (int i = 0; i < 3; i++)
+    {
+        const float *from = points[(i + 1) % 3], *to = points[(i + 2) % 3];
+        float dx = to[0] - from[0], dy = to[1] - from[1];
+
+        triangle.edges[i][0] = dy;
+        triangle.edges[i][1] = -dx;
+        triangle.edges[i][2] = dx * from[1] - dy * from[0];
+
+        // Top-left rule: pixels exactly on a shared edge belong to one triangle
+        triangle.inclusive[i] = dy > 0 || (dy == 0 && dx < 0);
+    }
+
+    for (int term = 0; term < 3; term++)
+    {
+        triangle.u[term] = 0;
+        triangle.v[term] = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            triangle.u[term] += triangle.edges[i][term] * points[i][2] / area;
+            triangle.v[term] += triangle.edges[i][term] * points[i][3] / area;
+        }
+    }
+    triangle.texture = texture;
+    triangle.texels = texels;
+
+    uint32_t index = (uint32_t) triangles.size();
+    triangles.push_back(triangle);
+
+    for (int tileY = triangle.minY / TILE_SIZE; tileY <= (triangle.maxY - 1) / TILE_SIZE; tileY++)
+    {
+        for (int tileX = triangle.minX / TILE_SIZE; tileX <= (triangle.maxX - 1) / TILE_SIZE; tileX++)
+        {
+            bins[tileY * tilesAcross + tileX].push_back(index);
+        }
+    }
+}
+
+void SoftwareRenderer::RasterizeTile(int tileX, int tileY)
+{
+    int left = tileX * TILE_SIZE, top = tileY * TILE_SIZE;
+    int right = std::min(width, left + TILE_SIZE), bottom = std::min(height, top + TILE_SIZE);
+
+    for (int y = top; y < bottom; y++)
+    {
+        std::fill(&framebuffer[y * stride + left], &framebuffer[y * stride + right], clearColor);
+    }
+
+    for (uint32_t index : bins[tileY * tilesAcross + tileX])
+    {
+        RasterizeTriangle(triangles[index], left, top, right, bottom);
+    }
+}
+
+void SoftwareRenderer::RasterizeTriangle(const ScreenTriangle &triangle, int left, int top, int right, int bottom)
+{
+    // Spans start on a multiple of four so every group of four stays inside
+    // this tile and the padded row
+    int startX = std::max(triangle.minX, left) & ~3;
+    int endX = std::min(triangle.maxX, right);
+    int startY = std::max(triangle.minY, top);
+    int endY = std::min(triangle.maxY, bottom);
+
+    const float (*edges)[3] = triangle.edges;
+    const SoftwareTexture &texture = *triangle.texture;
+
+    for (int y = startY; y < endY; y++)
+    {
+        uint32_t *row = &framebuffer[y * stride];
+        float centerY = y + 0.5f;
+
+        // Everything that only depends on y
+        float edgeRow[3];
+        for (int e = 0; e < 3; e++) edgeRow[e] = edges[e][1] * centerY + edges[e][2];
+        float uRow = triangle.u[1] * centerY + triangle.u[2];
+        float vRow = triangle.v[1] * centerY + triangle.v[2];
+
+        for (int x = startX; x < endX; x += 4)
+        {
+            // Which of the four pixels are covered, and the texel each one samples
+            int covered = 0;
+            int32_t texelX[4], texelY[4];
+
+#ifdef SOFTWARE_RENDERER_SSE2
+            const __m128 zero = _mm_setzero_ps();
+            __m128 centerX = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+
+            __m128 inside = _mm_cmplt_ps(centerX, _mm_set1_ps((float) endX));
+            for (int e = 0; e < 3; e++)
+            {
+                __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[e][0]), centerX), _mm_set1_ps(edgeRow[e]));
+                __m128 edgeInside = _mm_cmpgt_ps(value, zero);
+                if (triangle.inclusive[e]) edgeInside = _mm_or_ps(edgeInside, _mm_cmpeq_ps(value, zero));
+                inside = _mm_and_ps(inside, edgeInside);
+            }
+
+            covered = _mm_movemask_ps(inside);
+            if (covered == 0) continue;
+
+            __m128 u = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.u[0]), centerX), _mm_set1_ps(uRow));
+            __m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.v[0]), centerX), _mm_set1_ps(vRow));
+            _mm_storeu_si128((__m128i*) texelX, texel_coordinate4(u, texture.width, texture.clamp));
+            _mm_storeu_si128((__m128i*) texelY, texel_coordinate4(v, texture.height, texture.clamp));
+#else
+            for (int i = 0; i < 4 && x + i < endX; i++)
+            {
+                float centerX = x + i + 0.5f;
+
+                bool inside = true;
+                for (int e = 0; e < 3 && inside; e++)
+                {
+                    float value = edges[e][0] * centerX + edgeRow[e];
+                    inside = value > 0 || (value == 0 && triangle.inclusive[e]);
+                }
+                if (!inside) continue;
+
+                covered |= 1 << i;
+                texelX[i] = texel_coordinate(triangle.u[0] * centerX + uRow, texture.width, texture.clamp);
+                texelY[i] = texel_coordinate(triangle.v[0] * centerX + vRow, texture.height, texture.clamp);
+            }
+            if (covered == 0) continue;
+#endif
+
+            uint32_t source[4] = { 0, 0, 0, 0 };
+            uint32_t mask[4] = { 0, 0, 0, 0 };
+            bool any = false;
+            for (int i = 0; i < 4; i++)
+            {
+                if ((covered & (1 << i)) == 0) continue;
+
+                // Fully transparent texels would blend to the same pixel anyway
+                source[i] = triangle.texels[texelY[i] * texture.width + texelX[i]];
+                if (source[i] == 0) continue;
+                mask[i] = 0xFFFFFFFF;
+                any = true;
+            }
+
+            if (any) blend4(&row[x], source, mask);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+//
+//  SoftwareRenderer.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef SoftwareRenderer_h
+#define SoftwareRenderer_h
+
+#include <stdint.h>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+
+/**
+ * A texture as the software renderer samples it: premultiplied RGBA8, top
+ * row first, the same bytes the GL path uploads as level 0. An indexed
+ * texture is expanded through its palette, one whole image per palette row,
+ * one after the other.
+ */
+struct SoftwareTexture {
+    int width = 0;
+    int height = 0;
+    int paletteRows = 1;
+    bool clamp = false;
+    std::vector<uint32_t> texels;
+};
+
+/**
+ * Draws a RenderQueue into an RGBA8 framebuffer in memory, without a GL
+ * context, for headless servers, golden images and streaming.
+ *
+ * It consumes exactly what RenderQueue::Execute would draw: the same sorted
+ * batches over the same vertex stream, with premultiplied "over" blending and
+ * nearest sampling. Triangles are binned into 64x64 pixel tiles and every
+ * tile is rasterized as a job on the renderer's own thread pool, so tiles
+ * never share pixels and need no locking; within a tile triangles keep
+ * their queue order. The same pool writes the queue's vertex stream. Blending runs four pixels at a time with SSE2 where the
+ * compiler has it, and falls back to plain C++ elsewhere.
+ */
+class SoftwareRenderer {
+public:
+    static const int TILE_SIZE = 64;
+
+    SoftwareRenderer(int width, int height, int threadCount);
+
+    // Texture ids are the ones the queue was given. Copies the pixels.
+    void SetTexture(GLuint textureID, int width, int height, const unsigned char *pixels, bool clamp);
+
+    // Indices into `paletteRows` rows of COOKED_PALETTE_SIZE RGBA8 colours
+    void SetPalettedTexture(GLuint textureID, int width, int height, const unsigned char *indices,
+                            const unsigned char *palette, int paletteRows, bool clamp);
+
+    void SetClearColor(float red, float green, float blue, float alpha);
+
+    void Draw(RenderQueue &queue, const glm::mat4 &projection, const glm::mat4 &view);
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    // Pixels per row in Pixels(); rows are padded to a multiple of four
+    int Stride() const { return stride; }
+
+    // RGBA8, top row first
+    const uint32_t *Pixels() const { return framebuffer.data(); }
+
+private:
+    // A triangle in pixel space, set up once and shared by every tile it
+    // touches. Edge i is inside where a*x + b*y + c > 0 (or == 0 on a
+    // top or left edge); u and v are planes over the same x and y.
+    struct ScreenTriangle {
+        float edges[3][3];
+        bool inclusive[3];
+        float u[3];
+        float v[3];
+        int minX, minY, maxX, maxY;
+        const SoftwareTexture *texture;
+        const uint32_t *texels;   // the image for the triangle's palette row
+    };
+
+    void Setup(RenderQueue &queue, const glm::mat4 &projection, const glm::mat4 &view);
+    void AddTriangle(const float *a, const float *b, const float *c, const SoftwareTexture *texture, const uint32_t *texels);
+    void RasterizeTile(int tileX, int tileY);
+    void RasterizeTriangle(const ScreenTriangle &triangle, int left, int top, int right, int bottom);
+
+    int width;
+    int height;
+    int stride;
+    int tilesAcross;
+    int tilesDown;
+
+    uint32_t clearColor = 0;
+    std::vector<uint32_t> framebuffer;
+
+    std::vector<SoftwareTexture> textures;   // indexed by texture id
+    std::vector<ScreenTriangle> triangles;
+    std::vector<std::vector<uint32_t>> bins; // triangle indices per tile, in draw order
+
+    ThreadPool pool;
+};
+
+#endif /* SoftwareRenderer_h */
@@ -0,0 +1,58 @@
+//
+//  SpriteAnimation.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include <cmath>
+#include "SpriteAnimation.h"
+
+int SpriteAnimation::AddClip(const int *clipFrames, int frameCount, float fps, int cols, int rows)
+{
+    if ((int) clips.size() == MAX_CLIPS || (int) frames.size() + frameCount > MAX_FRAMES || frameCount <= 0) return -1;
+
+    clips.push_back({ (int) frames.size(), frameCount, fps, cols, rows });
+    frames.insert(frames.end(), clipFrames, clipFrames + frameCount);
+    return (int) clips.size() - 1;
+}
+
+int SpriteAnimation::Phase(int clip, float startTime) const
+{
+    const Clip &c = clips[clip];
+    int step = (int) std::floor(startTime * c.fps) % c.frameCount;
+    return (c.frameCount - step) % c.frameCount;
+}
+
+void SpriteAnimation::FrameUV(int clip, float time, int phase, float uv[4]) const
+{
+    // Same arithmetic, in the same precision, as vertex_animated_330.glsl
+    const Clip &c = clips[clip];
+    int step = (int) std::fmod(std::floor(time * c.fps) + phase, (float) c.frameCount);
+    int frame = frames[c.first + step];
+
+    float width = 1.0f / (float) c.cols;
+    float height = 1.0f / (float) c.rows;
+    uv[0] = (float) (frame % c.cols) * width;
+    uv[1] = (float) (frame / c.cols) * height;
+    uv[2] = uv[0] + width;
+    uv[3] = uv[1] + height;
+}
+
+void SpriteAnimation::Pack(std::vector<float> &block) const
+{
+    block.assign(4 * 2 * MAX_CLIPS + MAX_FRAMES, 0.0f);
+
+    for (int i = 0; i < (int) clips.size(); i++)
+    {
+        float *timing = &block[4 * 2 * i];
+        timing[0] = (float) clips[i].first;
+        timing[1] = (float) clips[i].frameCount;
+        timing[2] = clips[i].fps;
+        timing[4] = (float) clips[i].cols;
+        timing[5] = (float) clips[i].rows;
+    }
+
+    float *table = &block[4 * 2 * MAX_CLIPS];
+    for (int i = 0; i < (int) frames.size(); i++) table[i] = (float) frames[i];
+}
@@ -0,0 +1,62 @@
+//
+//  SpriteAnimation.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef SpriteAnimation_h
+#define SpriteAnimation_h
+
+#include <vector>
+
+/**
+ * Sprite animation clips, evaluated from a clock instead of stepped.
+ *
+ * A clip is a list of frames in an atlas grid, played in a loop at a fixed
+ * rate. An animated sprite only carries its clip and a phase, the number of
+ * frames it runs ahead of the clock, so at time t it shows frame
+ * (floor(t * fps) + phase) mod frameCount of its clip. Nothing about it
+ * changes from one frame to the next.
+ *
+ * On a core context the sprite vertex shader does that sum itself, from a
+ * time uniform and the whole table in a uniform buffer (see Pack()), so
+ * animating costs the CPU nothing per sprite. Everywhere else RenderQueue
+ * does it with FrameUV() while building the vertex stream.
+ *
+ * Clips are added before the render thread starts and never change after.
+ */
+class SpriteAnimation {
+public:
+    static const int MAX_CLIPS = 32;
+    static const int MAX_FRAMES = 256;   // across all clips
+
+    // The new clip's id, or -1 when the table is full
+    int AddClip(const int *frames, int frameCount, float fps, int cols, int rows);
+    int ClipCount() const { return (int) clips.size(); }
+
+    // The phase that puts the clip on its first frame at `startTime`
+    int Phase(int clip, float startTime) const;
+
+    // The atlas rectangle shown at `time`: u0, v0 (top left), u1, v1
+    void FrameUV(int clip, float time, int phase, float uv[4]) const;
+
+    // The table as the shaders' std140 Clips block:
+    //     vec4 clips[2 * MAX_CLIPS];    // (first, frameCount, fps, 0), (cols, rows, 0, 0)
+    //     vec4 frames[MAX_FRAMES / 4];  // four frame indices each
+    void Pack(std::vector<float> &block) const;
+
+private:
+    struct Clip {
+        int first;        // into frames
+        int frameCount;
+        float fps;
+        int cols;
+        int rows;
+    };
+
+    std::vector<Clip> clips;
+    std::vector<int> frames;
+};
+
+#endif /* SpriteAnimation_h */
@@ -0,0 +1,161 @@
+//
+//  StreamBuffer.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+
+#include <algorithm>
+#include <cstdio>
+#include "StreamBuffer.h"
+
+// GL 4.4 names, missing from older headers
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// Looked up at runtime: macOS has no such entry point to link against
+typedef void (APIENTRY *BufferStorageFunction)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+static BufferStorageFunction buffer_storage = NULL;
+
+const GLbitfield PERSISTENT_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+const size_t REGION_ALIGNMENT = 256;       // keeps every region and allocation start a whole number of vertices
+const GLuint64 WAIT_TIMEOUT = 1000000;     // nanoseconds per wait before asking again
+
+StreamBuffer::StreamBuffer(size_t regionBytes)
+{
+    int major = 0, minor = 0;
+    const char *version = (const char *) glGetString(GL_VERSION);
+    if (version != NULL) sscanf(version, "%d.%d", &major, &minor);
+
+    if (major > 4 || (major == 4 && minor >= 4) || SDL_GL_ExtensionSupported("GL_ARB_buffer_storage"))
+    {
+        buffer_storage = (BufferStorageFunction) SDL_GL_GetProcAddress("glBufferStorage");
+    }
+    persistent = buffer_storage != NULL;
+
+    Allocate(regionBytes);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    Release();
+}
+
+void StreamBuffer::Allocate(size_t bytes)
+{
+    regionBytes = (bytes + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT;
+    region = 0;
+    regionUsed = 0;
+    generation++;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    if (persistent)
+    {
+        buffer_storage(GL_ARRAY_BUFFER, regionBytes * REGION_COUNT, NULL, PERSISTENT_FLAGS);
+        mapped = (unsigned char *) glMapBufferRange(GL_ARRAY_BUFFER, 0, regionBytes * REGION_COUNT, PERSISTENT_FLAGS);
+
+        // Storage is immutable, so a failed map means starting over without it
+        if (mapped == NULL)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            persistent = false;
+            Allocate(bytes);
+            return;
+        }
+    }
+    else
+    {
+        // Orphaning renames the whole buffer, so one region is enough
+        glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StreamBuffer::Release()
+{
+    for (GLsync &fence : fences)
+    {
+        if (fence != NULL) glDeleteSync(fence);
+        fence = NULL;
+    }
+
+    if (mapped != NULL)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mapped = NULL;
+    }
+
+    // Draws still reading the old storage keep it alive until they finish
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void *StreamBuffer::Begin(size_t bytes, size_t *offset)
+{
+    // Orphaning starts every upload at the front of fresh storage
+    size_t start = persistent ? (regionUsed + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT : 0;
+    if (start + bytes > regionBytes)
+    {
+        Release();
+        Allocate(std::max(start + bytes, regionBytes * 2));
+        start = 0;
+    }
+
+    if (!persistent)
+    {
+        if (staging.size() < bytes) staging.resize(bytes);
+        stagedBytes = bytes;
+        *offset = 0;
+        return staging.data();
+    }
+
+    // Wait only if the GPU has not got past this region's last use yet;
+    // the first Begin() of a frame clears the fence for the rest of it
+    GLsync &fence = fences[region];
+    if (fence != NULL)
+    {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            stalls++;
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT) == GL_TIMEOUT_EXPIRED) {}
+        }
+        glDeleteSync(fence);
+        fence = NULL;
+    }
+
+    regionUsed = start + bytes;
+    *offset = region * regionBytes + start;
+    return mapped + *offset;
+}
+
+void StreamBuffer::End()
+{
+    if (persistent || stagedBytes == 0) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, stagedBytes, staging.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StreamBuffer::Fence()
+{
+    if (!persistent) return;
+
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % REGION_COUNT;
+    regionUsed = 0;
+}
@@ -0,0 +1,83 @@
+//
+//  StreamBuffer.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef StreamBuffer_h
+#define StreamBuffer_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * A vertex buffer for data rewritten every frame, split into REGION_COUNT
+ * regions that take turns.
+ *
+ * With ARB_buffer_storage (GL 4.4) the whole buffer is mapped once,
+ * persistently and coherently, and Begin() hands out a pointer straight
+ * into the frame's region, so whatever builds the vertices writes them
+ * where the GPU reads them. A frame can Begin() several times; each gets
+ * the next part of the region. Fence() ends the frame with a sync object
+ * after the draws that read its region; the CPU only waits on it when it
+ * comes back round to that region REGION_COUNT frames later with the GPU
+ * still behind.
+ *
+ * Without buffer storage (macOS tops out at 4.1) Begin() hands out CPU
+ * memory instead and End() orphans the buffer and copies into the fresh
+ * storage, which lets the driver do the same renaming behind our back.
+ *
+ * A frame bigger than a region grows the buffer, which replaces it with a
+ * new buffer object; vertex arrays pointing at it have to be set up again.
+ * The new one can come back under the old name, so Generation() is what
+ * tells. Needs a 3.3 context current for everything, destruction included.
+ */
+class StreamBuffer {
+public:
+    static const int REGION_COUNT = 3;
+
+    StreamBuffer(size_t regionBytes);
+    ~StreamBuffer();
+
+    bool IsPersistent() const { return persistent; }
+    GLuint Buffer() const { return buffer; }
+    int Generation() const { return generation; }   // bumped every time Buffer() is replaced
+
+    // Space for `bytes` this frame, and where in Buffer() it will be once End() returns
+    void *Begin(size_t bytes, size_t *offset);
+    void End();
+
+    // Once per frame, after the draws that read this frame's data
+    void Fence();
+
+    int Stalls() const { return stalls; }
+
+private:
+    void Allocate(size_t bytes);
+    void Release();
+
+    bool persistent;
+    size_t regionBytes = 0;
+    GLuint buffer = 0;
+    int generation = 0;
+    unsigned char *mapped = NULL;
+
+    GLsync fences[REGION_COUNT] = {};
+    int region = 0;
+    size_t regionUsed = 0;   // bytes of the current region handed out this frame
+
+    std::vector<unsigned char> staging;
+    size_t stagedBytes = 0;
+
+    int stalls = 0;
+};
+
+#endif /* StreamBuffer_h */
@@ -0,0 +1,136 @@
+//
+//  TextRenderer.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include <algorithm>
+#include <functional>
+#include "glm/gtc/matrix_transform.hpp"
+#include "TextRenderer.h"
+
+const int VERTICES_PER_GLYPH = 6;
+
+size_t TextRenderer::RunKeyHash::operator()(const RunKey &key) const
+{
+    size_t hash = std::hash<std::string>()(key.text);
+    hash = hash * 31 + std::hash<float>()(key.size);
+    hash = hash * 31 + std::hash<float>()(key.spacing);
+    return hash;
+}
+
+void TextRenderer::SetFont(ShaderProgram *fontProgram, GLuint fontTextureID)
+{
+    program = fontProgram;
+    textureID = fontTextureID;
+}
+
+std::shared_ptr<const GlyphRun> TextRenderer::Layout(const std::string &text, float size, float spacing) const
+{
+    auto run = std::make_shared<GlyphRun>();
+    run->vertices.resize(text.size() * VERTICES_PER_GLYPH * RenderQueue::FLOATS_PER_VERTEX);
+    float *vertex = run->vertices.data();
+
+    float width = 1.0f / (float) GLYPH_COLUMNS;
+    float height = 1.0f / (float) GLYPH_COLUMNS;
+
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        int index = (unsigned char) text[i];
+        float offset = (size + spacing) * i;
+
+        float u = (float) (index % GLYPH_COLUMNS) / (float) GLYPH_COLUMNS;
+        float v = (float) (index / GLYPH_COLUMNS) / (float) GLYPH_COLUMNS;
+
+        const float glyph[] = {
+            offset + (-0.5f * size), 0.5f * size,  u, v,
+            offset + (-0.5f * size), -0.5f * size, u, v + height,
+            offset + (0.5f * size), 0.5f * size,   u + width, v,
+            offset + (0.5f * size), -0.5f * size,  u + width, v + height,
+            offset + (0.5f * size), 0.5f * size,   u + width, v,
+            offset + (-0.5f * size), -0.5f * size, u, v + height,
+        };
+
+        std::copy(glyph, glyph + sizeof(glyph) / sizeof(glyph[0]), vertex);
+        vertex += sizeof(glyph) / sizeof(glyph[0]);
+    }
+
+    return run;
+}
+
+std::shared_ptr<const GlyphRun> TextRenderer::Find(const std::string &text, float size, float spacing)
+{
+    RunKey key = { text, size, spacing };
+    auto found = cache.find(key);
+    if (found == cache.end())
+    {
+        found = cache.emplace(std::move(key), CachedRun { Layout(text, size, spacing), frame }).first;
+        layouts++;
+    }
+
+    found->second.lastUsed = frame;
+    return found->second.run;
+}
+
+void TextRenderer::Emit(RenderQueue *queue, const GlyphRun &run, glm::vec3 position)
+{
+    if (run.vertices.empty()) return;
+
+    int firstVertex;
+    float *vertex = queue->AllocateVertices(run.VertexCount(), &firstVertex);
+    std::copy(run.vertices.begin(), run.vertices.end(), vertex);
+
+    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
+    queue->SubmitVertices(LAYER_UI, 0.0f, program, textureID, modelMatrix, firstVertex, run.VertexCount());
+}
+
+void TextRenderer::Draw(RenderQueue *queue, const std::string &text, float size, float spacing, glm::vec3 position)
+{
+    Emit(queue, *Find(text, size, spacing), position);
+}
+
+int TextRenderer::Add(const std::string &text, float size, float spacing, glm::vec3 position, bool visible)
+{
+    retained.push_back({ text, size, spacing, position, visible, Find(text, size, spacing) });
+    return (int) retained.size() - 1;
+}
+
+void TextRenderer::Set(int id, const std::string &text)
+{
+    RetainedText &entry = retained[id];
+    if (entry.text == text) return;
+
+    entry.text = text;
+    entry.run = Find(text, entry.size, entry.spacing);
+}
+
+void TextRenderer::SetVisible(int id, bool visible)
+{
+    retained[id].visible = visible;
+}
+
+void TextRenderer::Submit(RenderQueue *queue)
+{
+    for (const RetainedText &entry : retained)
+    {
+        if (entry.visible) Emit(queue, *entry.run, entry.position);
+    }
+}
+
+void TextRenderer::EndFrame()
+{
+    // Retained strings hold their own runs, so dropping one here never loses text
+    frame++;
+    for (auto entry = cache.begin(); entry != cache.end(); )
+    {
+        if (frame - entry->second.lastUsed > IDLE_FRAMES)
+        {
+            entry = cache.erase(entry);
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+}
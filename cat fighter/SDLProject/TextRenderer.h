@@ -0,0 +1,105 @@
+//
+//  TextRenderer.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef TextRenderer_h
+#define TextRenderer_h
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "glm/vec3.hpp"
+#include "RenderQueue.h"
+
+/**
+ * A laid-out string: two triangles per glyph in the string's own space,
+ * as x, y, u, v. Never modified once built.
+ */
+struct GlyphRun {
+    std::vector<float> vertices;
+    int VertexCount() const { return (int) vertices.size() / RenderQueue::FLOATS_PER_VERTEX; }
+};
+
+/**
+ * Text in a 16 x 16 ASCII font atlas, laid out once and drawn many times.
+ *
+ * Every (string, size, spacing) is laid out into a GlyphRun the first time
+ * it is drawn and kept in a cache; runs nobody has drawn for IDLE_FRAMES
+ * frames are dropped, so a HUD counting up does not grow it forever.
+ * Drawing a cached run is a copy into the render queue's vertex arena, and
+ * as all text shares a shader and the font, the queue merges a frame's
+ * text into one draw.
+ *
+ * Retained strings sit on top of that for text that stays on screen: they
+ * are created once, hold on to their run and only look it up again when
+ * Set() actually changes their text.
+ *
+ * Not thread-safe; each thread that draws text keeps its own.
+ */
+class TextRenderer {
+public:
+    static const int GLYPH_COLUMNS = 16;
+    static const int IDLE_FRAMES = 120;
+
+    void SetFont(ShaderProgram *program, GLuint textureID);
+
+    // Immediate: this frame only
+    void Draw(RenderQueue *queue, const std::string &text, float size, float spacing, glm::vec3 position);
+
+    // Retained: an id for Set(), SetVisible() and Submit()
+    int Add(const std::string &text, float size, float spacing, glm::vec3 position, bool visible = true);
+    void Set(int id, const std::string &text);
+    void SetVisible(int id, bool visible);
+    void Submit(RenderQueue *queue);
+
+    // Once per frame, after the frame's text is drawn
+    void EndFrame();
+
+    int CachedRuns() const { return (int) cache.size(); }
+    int Layouts() const { return layouts; }
+
+private:
+    struct RunKey {
+        std::string text;
+        float size;
+        float spacing;
+        bool operator==(const RunKey &other) const { return text == other.text && size == other.size && spacing == other.spacing; }
+    };
+
+    struct RunKeyHash {
+        size_t operator()(const RunKey &key) const;
+    };
+
+    struct CachedRun {
+        std::shared_ptr<const GlyphRun> run;
+        int lastUsed;
+    };
+
+    struct RetainedText {
+        std::string text;
+        float size;
+        float spacing;
+        glm::vec3 position;
+        bool visible;
+        std::shared_ptr<const GlyphRun> run;
+    };
+
+    std::shared_ptr<const GlyphRun> Find(const std::string &text, float size, float spacing);
+    std::shared_ptr<const GlyphRun> Layout(const std::string &text, float size, float spacing) const;
+    void Emit(RenderQueue *queue, const GlyphRun &run, glm::vec3 position);
+
+    ShaderProgram *program = NULL;
+    GLuint textureID = 0;
+
+    std::unordered_map<RunKey, CachedRun, RunKeyHash> cache;
+    std::vector<RetainedText> retained;
+
+    int frame = 0;
+    int layouts = 0;
+};
+
+#endif /* TextRenderer_h */
@@ -0,0 +1,125 @@
+//
+//  TextureUploader.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#define GL_SILENCE_DEPRECATION
+
+#include <algorithm>
+#include <cstring>
+#include "TextureUploader.h"
+
+const GLint TEXTURE_BORDER = 0;
+const GLint DEFAULT_UNPACK_ALIGNMENT = 4;
+
+TextureUploader::TextureUploader(size_t bytesPerFrame) : bytesPerFrame(bytesPerFrame)
+{
+    glGenBuffers(1, &buffer);
+}
+
+TextureUploader::~TextureUploader()
+{
+    glDeleteBuffers(1, &buffer);
+}
+
+void TextureUploader::Queue(GLuint textureID, GLint level, GLint internalFormat, int width, int height, GLenum format, int texelSize,
+                            const unsigned char *pixels)
+{
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, TEXTURE_BORDER, format, GL_UNSIGNED_BYTE, NULL);
+
+    levels.push_back({ textureID, level, width, height, format, false, height, (size_t) width * texelSize, pixels, 0 });
+}
+
+void TextureUploader::QueueBlocks(GLuint textureID, GLint level, GLenum internalFormat, int width, int height, int blockSize,
+                                  const unsigned char *blocks)
+{
+    // Levels under 4x4 still take a whole block
+    int columns = (width + 3) / 4, rows = (height + 3) / 4;
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, TEXTURE_BORDER, columns * rows * blockSize, NULL);
+
+    levels.push_back({ textureID, level, width, height, internalFormat, true, rows, (size_t) columns * blockSize, blocks, 0 });
+}
+
+void TextureUploader::Pump(std::vector<GLuint> &finished)
+{
+    if (levels.empty()) return;
+
+    // This frame's share of the rows, worked out first so the buffer is mapped once
+    slices.clear();
+    size_t used = 0;
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        const Level &level = levels[i];
+        int rows = level.rows - level.rowsDone;
+        if (used + level.rowBytes > bytesPerFrame)
+        {
+            // One row always goes, or a budget smaller than a row would never finish
+            if (used > 0) break;
+            rows = 1;
+        }
+        else
+        {
+            rows = std::min(rows, (int) ((bytesPerFrame - used) / level.rowBytes));
+        }
+
+        slices.push_back({ i, level.rowsDone, rows, used });
+        used += rows * level.rowBytes;
+        if (level.rowsDone + rows < level.rows) break;
+    }
+
+    // Orphaning gives the buffer fresh storage, so nothing waits on last frame's copies
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, used, NULL, GL_STREAM_DRAW);
+    unsigned char *mapped = (unsigned char *) glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (mapped != NULL)
+    {
+        for (const Slice &slice : slices)
+        {
+            const Level &level = levels[slice.level];
+            memcpy(mapped + slice.offset, level.pixels + slice.firstRow * level.rowBytes, slice.rows * level.rowBytes);
+        }
+        if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) mapped = NULL;   // contents lost; send them again below
+    }
+
+    // Without a mapping the rows come straight from client memory instead
+    if (mapped == NULL) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // Rows are packed back to back, whatever their width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (const Slice &slice : slices)
+    {
+        Level &level = levels[slice.level];
+        const unsigned char *source = mapped != NULL ? (const unsigned char *) NULL + slice.offset
+                                                     : level.pixels + slice.firstRow * level.rowBytes;
+        glBindTexture(GL_TEXTURE_2D, level.textureID);
+        if (level.blocks)
+        {
+            // The last row of blocks may hang over the bottom edge
+            int top = slice.firstRow * 4;
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level.level, 0, top, level.width, std::min(slice.rows * 4, level.height - top), level.format,
+                                      (GLsizei) (slice.rows * level.rowBytes), source);
+        }
+        else
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, level.level, 0, slice.firstRow, level.width, slice.rows, level.format, GL_UNSIGNED_BYTE, source);
+        }
+        level.rowsDone += slice.rows;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, DEFAULT_UNPACK_ALIGNMENT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    bytesUploaded += used;
+
+    // A texture is done once none of its levels are left
+    while (!levels.empty() && levels.front().rowsDone == levels.front().rows)
+    {
+        GLuint textureID = levels.front().textureID;
+        levels.pop_front();
+        bool more = false;
+        for (const Level &level : levels) more = more || level.textureID == textureID;
+        if (!more) finished.push_back(textureID);
+    }
+}
@@ -0,0 +1,86 @@
+//
+//  TextureUploader.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef TextureUploader_h
+#define TextureUploader_h
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+
+/**
+ * Feeds texture levels to GL a few rows at a time, so that no frame spends
+ * more than its byte budget on uploads however big the image.
+ *
+ * Queue() allocates the level straight away, with no pixels. Each Pump()
+ * then orphans one pixel unpack buffer, maps it, copies in as many rows
+ * as fit in the budget (always at least one), and issues a
+ * glTexSubImage2D per level from offsets into it. The driver copies from
+ * the buffer in its own time, not during the call. Levels go in the order
+ * they were queued.
+ *
+ * Block-compressed levels, from QueueBlocks(), go the same way a row of
+ * 4x4 blocks at a time, through glCompressedTexSubImage2D.
+ *
+ * The caller keeps a level's pixels alive until Pump() reports its
+ * texture finished, and should not draw the texture before then. Needs
+ * the GL context current for everything, destruction included.
+ */
+class TextureUploader {
+public:
+    TextureUploader(size_t bytesPerFrame);
+    ~TextureUploader();
+
+    void SetBytesPerFrame(size_t bytes) { bytesPerFrame = bytes; }
+
+    void Queue(GLuint textureID, GLint level, GLint internalFormat, int width, int height, GLenum format, int texelSize,
+               const unsigned char *pixels);
+    void QueueBlocks(GLuint textureID, GLint level, GLenum internalFormat, int width, int height, int blockSize,
+                     const unsigned char *blocks);
+
+    // Adds every texture whose last level went in to `finished`
+    void Pump(std::vector<GLuint> &finished);
+
+    bool IsIdle() const { return levels.empty(); }
+    size_t BytesUploaded() const { return bytesUploaded; }
+
+private:
+    struct Level {
+        GLuint textureID;
+        GLint level;
+        int width;
+        int height;
+        GLenum format;      // the internal format, for blocks
+        bool blocks;
+        int rows;           // of texels, or of blocks
+        size_t rowBytes;
+        const unsigned char *pixels;
+        int rowsDone;
+    };
+
+    struct Slice {
+        size_t level;   // index into levels
+        int firstRow;
+        int rows;
+        size_t offset;  // into the unpack buffer
+    };
+
+    size_t bytesPerFrame;
+    GLuint buffer = 0;
+    std::deque<Level> levels;
+    std::vector<Slice> slices;
+    size_t bytesUploaded = 0;
+};
+
+#endif /* TextureUploader_h */
@@ -0,0 +1,71 @@
+//
+//  ThreadPool.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount < 1) threadCount = 1;
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (std::thread &worker : workers) worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        jobs.push_back(std::move(job));
+        jobsInFlight++;
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    jobsDone.wait(lock, [this] { return jobsInFlight == 0; });
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            // Drain whatever is queued before honouring a stop request
+            if (jobs.empty()) return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            jobsInFlight--;
+            if (jobsInFlight == 0) jobsDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,47 @@
+//
+//  ThreadPool.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads pulling jobs off a shared FIFO. Jobs must not
+ * touch the GL context; anything that needs GL is handed back to the thread
+ * that owns it.
+ */
+class ThreadPool {
+public:
+    ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    void Submit(std::function<void()> job);
+    void Wait();
+
+    int ThreadCount() const { return (int) workers.size(); }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+
+    std::mutex jobsMutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+
+    int jobsInFlight = 0;
+    bool stopping = false;
+};
+
+#endif /* ThreadPool_h */
@@ -0,0 +1,128 @@
+//
+//  TileMap.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "TileMap.h"
+
+TileMap::TileMap(float tileSize) : tileSize(tileSize)
+{
+}
+
+uint64_t TileMap::ChunkKey(glm::vec2 position) const
+{
+    float chunkSize = tileSize * CHUNK_TILES;
+    int32_t x = (int32_t) std::floor(position.x / chunkSize);
+    int32_t y = (int32_t) std::floor(position.y / chunkSize);
+    return ((uint64_t) (uint32_t) x << 32) | (uint32_t) y;
+}
+
+void TileMap::ChunkCells(std::vector<Bounds2D> &cells) const
+{
+    float chunkSize = tileSize * CHUNK_TILES;
+    for (const auto &entry : chunks)
+    {
+        float x = (int32_t) (uint32_t) (entry.first >> 32) * chunkSize;
+        float y = (int32_t) (uint32_t) entry.first * chunkSize;
+        cells.push_back({ x, x + chunkSize, y, y + chunkSize });
+    }
+}
+
+void TileMap::SetTile(int id, glm::vec2 position, GLuint textureID)
+{
+    // A tile that moved to another chunk leaves its old one first
+    uint64_t key = ChunkKey(position);
+    auto previous = tileChunks.find(id);
+    if (previous != tileChunks.end() && previous->second != key) RemoveTile(id);
+
+    auto found = chunks.find(key);
+    if (found == chunks.end())
+    {
+        found = chunks.emplace(key, Chunk()).first;
+        found->second.serial = nextSerial++;
+    }
+
+    Chunk &chunk = found->second;
+    chunk.tiles[id] = { position, textureID };
+    chunk.dirty = true;
+    tileChunks[id] = key;
+}
+
+void TileMap::RemoveTile(int id)
+{
+    auto previous = tileChunks.find(id);
+    if (previous == tileChunks.end()) return;
+
+    Chunk &chunk = chunks[previous->second];
+    chunk.tiles.erase(id);
+    chunk.dirty = true;
+    if (chunk.tiles.empty()) chunks.erase(previous->second);
+
+    tileChunks.erase(previous);
+}
+
+void TileMap::Rebuild(Chunk &chunk)
+{
+    // One mesh per texture, each a list of quads in world space
+    std::map<GLuint, std::shared_ptr<StaticMesh>> built;
+    float half = tileSize * 0.5f;
+    chunk.bounds = { INFINITY, -INFINITY, INFINITY, -INFINITY };
+
+    for (const auto &entry : chunk.tiles)
+    {
+        const Tile &tile = entry.second;
+
+        std::shared_ptr<StaticMesh> &mesh = built[tile.textureID];
+        if (mesh == NULL)
+        {
+            mesh = std::make_shared<StaticMesh>();
+            mesh->id = ((uint64_t) chunk.serial << 32) | tile.textureID;
+            mesh->version = nextVersion++;
+        }
+
+        float x0 = tile.position.x - half, x1 = tile.position.x + half;
+        float y0 = tile.position.y - half, y1 = tile.position.y + half;
+
+        // Same corners and UVs as a sprite quad: v = 0 is the top of the image
+        const float quad[] = {
+            x0, y0, 0.0f, 1.0f,
+            x1, y0, 1.0f, 1.0f,
+            x1, y1, 1.0f, 0.0f,
+            x0, y0, 0.0f, 1.0f,
+            x1, y1, 1.0f, 0.0f,
+            x0, y1, 0.0f, 0.0f,
+        };
+        mesh->vertices.insert(mesh->vertices.end(), quad, quad + sizeof(quad) / sizeof(quad[0]));
+
+        chunk.bounds.left   = std::min(chunk.bounds.left, x0);
+        chunk.bounds.right  = std::max(chunk.bounds.right, x1);
+        chunk.bounds.bottom = std::min(chunk.bounds.bottom, y0);
+        chunk.bounds.top    = std::max(chunk.bounds.top, y1);
+    }
+
+    chunk.meshes.clear();
+    for (auto &mesh : built) chunk.meshes.push_back({ mesh.first, mesh.second });
+    chunk.dirty = false;
+}
+
+void TileMap::Submit(RenderQueue *queue, ShaderProgram *program, RenderLayer layer, const Bounds2D &view, CullStats *stats)
+{
+    for (auto &entry : chunks)
+    {
+        Chunk &chunk = entry.second;
+        if (chunk.dirty) Rebuild(chunk);
+
+        if (!overlaps(chunk.bounds, view))
+        {
+            if (stats != NULL) stats->culled += (int) chunk.tiles.size();
+            continue;
+        }
+
+        for (auto &mesh : chunk.meshes) queue->SubmitMesh(layer, 0.0f, program, mesh.first, mesh.second);
+        if (stats != NULL) stats->drawn += (int) chunk.tiles.size();
+    }
+}
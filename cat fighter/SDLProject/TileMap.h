@@ -0,0 +1,75 @@
+//
+//  TileMap.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef TileMap_h
+#define TileMap_h
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "glm/vec2.hpp"
+#include "Culling.h"
+#include "RenderQueue.h"
+
+/**
+ * Static level geometry, baked into chunks.
+ *
+ * Tiles are square sprites of one texture each, placed anywhere in the world
+ * and known by an id the caller picks. They are grouped into square chunks
+ * of CHUNK_TILES x CHUNK_TILES tiles by position. Each chunk keeps one
+ * StaticMesh per texture it uses, rebuilt only when one of its tiles is set
+ * or removed, and Submit() hands every visible chunk's meshes to the render
+ * queue as single draws. The cost of drawing the world then grows with the
+ * number of chunks on screen, not the number of tiles in the level.
+ *
+ * Lives on the simulation thread; the render thread only ever sees the
+ * immutable meshes.
+ */
+class TileMap {
+public:
+    static const int CHUNK_TILES = 16;
+
+    TileMap(float tileSize);
+
+    void SetTile(int id, glm::vec2 position, GLuint textureID);
+    void RemoveTile(int id);
+
+    void Submit(RenderQueue *queue, ShaderProgram *program, RenderLayer layer, const Bounds2D &view, CullStats *stats);
+
+    int TileCount() const { return (int) tileChunks.size(); }
+    int ChunkCount() const { return (int) chunks.size(); }
+
+    // The grid square of every chunk holding at least one tile
+    void ChunkCells(std::vector<Bounds2D> &cells) const;
+
+private:
+    struct Tile {
+        glm::vec2 position;
+        GLuint textureID;
+    };
+
+    struct Chunk {
+        uint32_t serial;                  // gives the chunk's meshes ids of their own
+        std::map<int, Tile> tiles;        // by id, so rebuilds come out in the same order
+        bool dirty = true;
+        Bounds2D bounds;
+        std::vector<std::pair<GLuint, std::shared_ptr<const StaticMesh>>> meshes;   // by texture
+    };
+
+    uint64_t ChunkKey(glm::vec2 position) const;
+    void Rebuild(Chunk &chunk);
+
+    float tileSize;
+    std::unordered_map<uint64_t, Chunk> chunks;
+    std::unordered_map<int, uint64_t> tileChunks;   // which chunk each tile id is in
+
+    uint32_t nextSerial = 0;
+    uint32_t nextVersion = 0;
+};
+
+#endif /* TileMap_h */
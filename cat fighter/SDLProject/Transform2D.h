@@ -0,0 +1,44 @@
+//
+//  Transform2D.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef Transform2D_h
+#define Transform2D_h
+
+#include <cmath>
+#include "glm/vec2.hpp"
+
+/**
+ * Where a sprite sits in the world: a position, a uniform scale and a
+ * rotation in radians, counterclockwise. 16 bytes, against the 64 of a
+ * model matrix; the render queue turns it into the 2D affine it stores
+ * per command, and only for what is actually drawn.
+ */
+struct Transform2D {
+    glm::vec2 position = glm::vec2(0.0f);
+    float scale = 1.0f;
+    float rotation = 0.0f;
+
+    // As a, b, c, d, tx, ty: x' = a*x + c*y + tx, y' = b*x + d*y + ty
+    void ToAffine(float affine[6]) const
+    {
+        float cosine = scale, sine = 0.0f;
+        if (rotation != 0.0f)
+        {
+            cosine = scale * std::cos(rotation);
+            sine = scale * std::sin(rotation);
+        }
+
+        affine[0] = cosine;
+        affine[1] = sine;
+        affine[2] = -sine;
+        affine[3] = cosine;
+        affine[4] = position.x;
+        affine[5] = position.y;
+    }
+};
+
+#endif /* Transform2D_h */
@@ -0,0 +1,52 @@
+//
+//  TripleBuffer.h
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+
+#ifndef TripleBuffer_h
+#define TripleBuffer_h
+
+#include <atomic>
+
+/**
+ * Lock-free hand-off of whole values from one writer thread to one reader
+ * thread. The writer always has a buffer of its own to fill, the reader
+ * always has the last complete one, and the third sits in the middle. Neither
+ * side ever waits for the other; a reader that falls behind simply skips to
+ * the newest value.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    // Writer side
+    T &WriteBuffer() { return buffers[writeIndex]; }
+
+    void Publish()
+    {
+        writeIndex = shared.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side; true when a newer value has been swapped in
+    bool Acquire()
+    {
+        if ((shared.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+
+        readIndex = shared.exchange(readIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    T &ReadBuffer() { return buffers[readIndex]; }
+
+private:
+    static const int INDEX = 0x3;
+    static const int FRESH = 0x4;   // set while the middle buffer hasn't been read
+
+    T buffers[3];
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> shared { 2 };
+};
+
+#endif /* TripleBuffer_h */
@@ -20,8 +20,34 @@
 #include "stb_image.h"
 #include "cmath"
 #include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include "Entity.h"
+#include "AssetLoader.h"
+#include "Culling.h"
+#include "RenderQueue.h"
+#include "RenderDevice.h"
+#include "TripleBuffer.h"
+#include "FramePacer.h"
+#include "SoftwareRenderer.h"
+#include "FrameCapture.h"
+#include "ImageIO.h"
+#include "GpuProfiler.h"
+#include "TileMap.h"
+#include "SpriteAnimation.h"
+#include "TextRenderer.h"
+#include "LayerCache.h"
+#include "ResolutionScaler.h"
+#include "ScaledTarget.h"
+#include "ThreadPool.h"
+#include "DebugDraw.h"
 
 /**
  STRUCTS AND ENUMS
@@ -34,12 +60,27 @@ struct GameState
     Entity *bg;
     Entity *bullets;
     Entity* enemy_bullets;
-
+    
+    GLuint font_texture_id;
     
     Mix_Music *bgm;
     Mix_Chunk *jump_sfx;
 };
 
+/**
+ * Everything the render thread needs to draw one frame, written by the
+ * simulation and never touched by it again once published.
+ */
+struct RenderSnapshot
+{
+    RenderQueue queue;
+    glm::mat4 view_matrix;
+    glm::mat4 projection_matrix;
+#ifdef DEBUG
+    DebugDrawList debug_shapes;
+#endif
+};
+
 /**
  CONSTANTS
  */
@@ -59,29 +100,174 @@ const int VIEWPORT_X = 0,
 const char V_SHADER_PATH[] = "shaders/vertex_textured.glsl",
            F_SHADER_PATH[] = "shaders/fragment_textured.glsl";
 
+const char V_SHADER_CORE_PATH[] = "shaders/vertex_textured_330.glsl",
+           F_SHADER_CORE_PATH[] = "shaders/fragment_textured_330.glsl",
+           V_SHADER_ANIMATED_PATH[] = "shaders/vertex_animated_330.glsl";
+
+#ifdef DEBUG
+const char V_SHADER_DEBUG_PATH[] = "shaders/vertex.glsl",
+           F_SHADER_DEBUG_PATH[] = "shaders/fragment.glsl",
+           V_SHADER_DEBUG_CORE_PATH[] = "shaders/vertex_330.glsl",
+           F_SHADER_DEBUG_CORE_PATH[] = "shaders/fragment_330.glsl";
+
+const glm::vec4 DEBUG_PLATFORM_COLOR(0.2f, 0.4f, 1.0f, 1.0f),
+                DEBUG_PLAYER_COLOR(0.2f, 1.0f, 0.2f, 1.0f),
+                DEBUG_ENEMY_COLOR(1.0f, 0.2f, 0.2f, 1.0f),
+                DEBUG_BULLET_COLOR(1.0f, 1.0f, 0.2f, 1.0f),
+                DEBUG_CHUNK_COLOR(1.0f, 1.0f, 1.0f, 0.25f),
+                DEBUG_CONTACT_COLOR(1.0f, 0.5f, 0.0f, 1.0f);
+const float DEBUG_NORMAL_LENGTH = 0.4f;   // world units
+#endif
+
 const float MILLISECONDS_IN_SECOND = 1000.0;
+
+const double TARGET_FPS = 60.0;                  // used when vsync is unavailable or off
+const VsyncMode REQUESTED_VSYNC = VSYNC_ADAPTIVE;
+const double TIMING_REPORT_INTERVAL = 5.0;       // seconds between frame timing logs
 const char SPRITESHEET_FILEPATH[] = "assets/cat_fighter_sprite1.png";
 const char PLATFORM_FILEPATH[]    = "assets/stone.png";
 const char BACKGROUND[] = "assets/Aibg.jpg";
-
-const int NUMBER_OF_TEXTURES = 1; // to be generated, that is
-const GLint LEVEL_OF_DETAIL  = 0;  // base image level; Level n is the nth mipmap reduction image
-const GLint TEXTURE_BORDER   = 0;   // this value MUST be zero
+const char FONT_FILEPATH[] = "assets/font1.png";
+const char BGM_FILEPATH[]  = "assets/mixkit-alter-ego-481.mp3";
+const char JUMP_SFX_FILEPATH[] = "assets/mixkit-video-game-spin-jump-2648.wav";
 
 const float PLATFORM_OFFSET = 5.0f;
 
+const float TILE_SIZE = 1.0f;  // world units per level tile
+
+// One profiler pass per render layer, in RenderLayer order
+const char *const RENDER_PASS_NAMES[] = { "background", "platforms", "sprites", "text" };
+const int RENDER_PASS_COUNT = sizeof(RENDER_PASS_NAMES) / sizeof(RENDER_PASS_NAMES[0]);
+const float PROFILER_TEXT_SIZE = 0.2f;
+
+const char DEFAULT_CAPTURE_DIRECTORY[] = "captures";
+const int DEFAULT_GOLDEN_TOLERANCE = 2;      // per channel, out of 255
+
+const int DEFAULT_TEXTURE_BUDGET_MB = 256;
+const int DEFAULT_UPLOAD_BUDGET_KB = 1024;
+
 /**
  VARIABLES
  */
 GameState state;
 
 SDL_Window* display_window;
+SDL_GLContext gl_context;
 bool game_is_running = true;
 
 ShaderProgram program;
 glm::mat4 view_matrix, projection_matrix;
 
-float previous_ticks = 0.0f;
+// Animated sprites play clips from this table, timed by the simulation clock.
+// On a core context animated_program works the frames out on the GPU.
+ShaderProgram animated_program;
+SpriteAnimation sprite_animation;
+int player_clips[5];
+double simulation_time = 0.0;
+
+// Text is laid out once per string. The banners are retained and only
+// shown or hidden; the profiler overlay draws from the render thread, so
+// it has a renderer of its own.
+TextRenderer hud_text;
+TextRenderer overlay_text;
+int win_banner, lose_banner;
+
+// --software draws on the CPU into a plain window; --headless does the same
+// with no window at all. Neither creates a GL context.
+bool use_software_renderer = false;
+bool headless = false;
+SoftwareRenderer *software_renderer = NULL;
+SDL_Surface *software_frame = NULL;
+
+// The GL path asks for a 3.3 core context first and falls back to the
+// legacy 2.1 one if that fails; --legacy-gl goes straight to the fallback.
+bool use_legacy_gl = false;
+bool core_profile = false;
+
+// Offscreen and regression runs. --offscreen draws into a framebuffer of its
+// own size with the window hidden (no window at all for software). --frames
+// runs a fixed number of frames, one simulation tick each, so the same frame
+// number always shows the same image; selected frames are saved as PNG and
+// optionally compared against golden images.
+bool offscreen = false;
+int render_width  = WINDOW_WIDTH,
+    render_height = WINDOW_HEIGHT;
+int frame_limit = 0;
+std::vector<int> capture_frames;
+std::string capture_directory = DEFAULT_CAPTURE_DIRECTORY;
+std::string golden_directory;
+int golden_tolerance = DEFAULT_GOLDEN_TOLERANCE;
+int golden_failures = 0;
+FrameCapture *frame_capture = NULL;
+std::vector<CapturedFrame> captured_frames;
+
+// GL path only. F3 toggles the overlay; --profile FILE logs every frame as CSV.
+GpuProfiler *gpu_profiler = NULL;
+RenderDevice *render_device = NULL;
+std::atomic<bool> show_profiler_overlay(false);
+const char *profile_log_path = NULL;
+
+// The background and level are drawn into a texture with this many pixels of
+// slack around the view and only redrawn when that runs out or they change.
+// --no-layer-cache draws them directly every frame.
+const int LAYER_CACHE_MARGIN = 64;
+bool use_layer_cache = true;
+LayerCache *layer_cache = NULL;
+
+// Opaque and cutout textures are drawn front to back against a depth buffer
+// and only the rest is blended; --no-materials blends everything in order.
+// F4 shows overdraw instead of colour: the brighter, the more often a pixel
+// was written.
+bool use_materials = true;
+std::atomic<bool> show_overdraw(false);
+
+// Sprite vertices are written by this many render workers as well as the
+// render thread once a frame has enough of them; --render-threads 0 keeps
+// it all on the render thread.
+int render_thread_count = -1;   // -1 until picked from the CPU count
+ThreadPool *render_workers = NULL;
+
+#ifdef DEBUG
+// Debug builds only. F5 outlines every collision box and tile chunk and
+// marks each contact with its normal; --debug-draw starts with it on. GL
+// path only.
+std::atomic<bool> show_debug_shapes(false);
+ShaderProgram debug_program;
+DebugDraw *debug_draw = NULL;
+#endif
+
+// Dynamic resolution. When frames take longer than --frame-budget (default
+// one TARGET_FPS period) of GPU time, everything below the UI is drawn at
+// a lower resolution and stretched to the window; the text stays sharp.
+// --resolution-scale fixes the scale instead, and --frames runs use a fixed
+// scale (1 unless given) so every run looks the same.
+bool use_dynamic_resolution = true;
+double frame_budget_ms = 1000.0 / TARGET_FPS;
+float fixed_resolution_scale = 1.0f;
+ResolutionScaler *resolution_scaler = NULL;
+ScaledTarget *scaled_target = NULL;
+int measured_frame = -1;
+
+TripleBuffer<RenderSnapshot> snapshots;
+std::thread render_thread;
+std::atomic<bool> render_thread_running(false);
+
+AssetLoader *asset_loader;
+
+// Textures not drawn in a frame are evicted, least recently used first, to
+// keep them all within --texture-budget MB; 0 never evicts. GL path only.
+int texture_budget_mb = DEFAULT_TEXTURE_BUDGET_MB;
+
+// Texels sent to GL per frame while textures stream in; --upload-budget KB.
+int upload_budget_kb = DEFAULT_UPLOAD_BUDGET_KB;
+
+TileMap level_tiles(TILE_SIZE);
+CullStats cull_stats;
+
+FramePacer *simulation_clock;
+FramePacer *render_pacer;
+
+double previous_ticks = 0.0;
 float accumulator = 0.0f;
 int shots_fired = 0;
 
@@ -90,86 +276,15 @@ int shots_fired = 0;
  */
 GLuint load_texture(const char* filepath)
 {
-    // STEP 1: Loading the image file
-    int width, height, number_of_components;
-    unsigned char* image = stbi_load(filepath, &width, &height, &number_of_components, STBI_rgb_alpha);
-    
-    if (image == NULL)
-    {
-        LOG("Unable to load image. Make sure the path is correct.");
-        assert(false);
-    }
-    
-    // STEP 2: Generating and binding a texture ID to our image
-    GLuint textureID;
-    glGenTextures(NUMBER_OF_TEXTURES, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    
-    // STEP 3: Setting our texture filter modes
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    
-    // STEP 4: Setting our texture wrapping modes
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // the last argument can change depending on what you are looking for
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    
-    // STEP 5: Releasing our file from memory and returning our texture id
-    stbi_image_free(image);
-    
-    return textureID;
+    // Decoding happens on the loader's workers; the id is usable immediately
+    // and picks up the real pixels once asset_loader->PumpTextures() uploads them
+    return asset_loader->LoadTexture(filepath);
 }
 
-void DrawText(ShaderProgram *program, GLuint fontTextureId, std::string text, float size, float spacing, glm::vec3 position) {
-    float width = 1.0f / 16.0f;
-    float height = 1.0f / 16.0f;
-    
-    std::vector<float> vertices;
-    std::vector<float> texCoords;
-    
-    for (int i = 0; i < text.size(); i++) {
-        int index = (int)text[i];
-        float offset = (size + spacing) * i;
-        
-        float u = (float)(index % 16) / 16.0f;
-        float v = (float)(index / 16) / 16.0f;
-        
-        vertices.insert(vertices.end(), {
-            offset + (-0.5f * size), 0.5f * size,
-            offset + (-0.5f * size), -0.5f * size,
-            offset + (0.5f * size), 0.5f * size,
-            offset + (0.5f * size), -0.5f * size,
-            offset + (0.5f * size), 0.5f * size,
-            offset + (-0.5f * size), -0.5f * size,
-        });
-        
-        texCoords.insert(texCoords.end(), {
-            u, v,
-            u, v + height,
-            u + width, v,
-            u + width, v + height,
-            u + width, v,
-            u, v + height,
-        });
-    }
-    
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, position);
-    program->SetModelMatrix(modelMatrix);
-    
-    glUseProgram(program->programID);
-    
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices.data());
-    glEnableVertexAttribArray(program->positionAttribute);
-    
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords.data());
-    glEnableVertexAttribArray(program->texCoordAttribute);
-
-    glBindTexture(GL_TEXTURE_2D, fontTextureId);
-    glDrawArrays(GL_TRIANGLES, 0, (int)(text.size() * 6));
-    
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+void start_music(Mix_Music *music)
+{
+    Mix_PlayMusic(music, -1);
+    Mix_VolumeMusic(MIX_MAX_VOLUME / 6.0f);
 }
 
 bool areEnemiesActive(Entity *enemies) {
@@ -179,35 +294,242 @@ bool areEnemiesActive(Entity *enemies) {
     return false;
 }
 
-void initialise()
+void parse_arguments(int argc, char* argv[])
 {
-    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
-    display_window = SDL_CreateWindow("Hello, AI!",
-                                      SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                                      WINDOW_WIDTH, WINDOW_HEIGHT,
-                                      SDL_WINDOW_OPENGL);
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--software")
+        {
+            use_software_renderer = true;
+        }
+        else if (argument == "--headless")
+        {
+            use_software_renderer = true;
+            headless = true;
+        }
+        else if (argument == "--legacy-gl")
+        {
+            use_legacy_gl = true;
+        }
+        else if (argument == "--no-layer-cache")
+        {
+            use_layer_cache = false;
+        }
+        else if (argument == "--no-materials")
+        {
+            use_materials = false;
+        }
+        else if (argument == "--overdraw")
+        {
+            show_overdraw = true;
+        }
+#ifdef DEBUG
+        else if (argument == "--debug-draw")
+        {
+            show_debug_shapes = true;
+        }
+#endif
+        else if (argument == "--render-threads" && i + 1 < argc)
+        {
+            render_thread_count = std::max(0, atoi(argv[++i]));
+        }
+        else if (argument == "--frame-budget" && i + 1 < argc)
+        {
+            frame_budget_ms = atof(argv[++i]);
+        }
+        else if (argument == "--resolution-scale" && i + 1 < argc)
+        {
+            fixed_resolution_scale = std::min(std::max((float) atof(argv[++i]), ResolutionScaler::LevelScale(ResolutionScaler::LEVELS - 1)), 1.0f);
+            use_dynamic_resolution = false;
+        }
+        else if (argument == "--offscreen" && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &render_width, &render_height) != 2 || render_width <= 0 || render_height <= 0)
+            {
+                LOG("Expected --offscreen WIDTHxHEIGHT, got " << argv[i]);
+                render_width = WINDOW_WIDTH;
+                render_height = WINDOW_HEIGHT;
+            }
+            offscreen = true;
+        }
+        else if (argument == "--frames" && i + 1 < argc)
+        {
+            frame_limit = atoi(argv[++i]);
+        }
+        else if (argument == "--capture" && i + 1 < argc)
+        {
+            std::stringstream list(argv[++i]);
+            std::string frame;
+            while (std::getline(list, frame, ',')) capture_frames.push_back(atoi(frame.c_str()));
+        }
+        else if (argument == "--capture-dir" && i + 1 < argc)
+        {
+            capture_directory = argv[++i];
+        }
+        else if (argument == "--golden" && i + 1 < argc)
+        {
+            golden_directory = argv[++i];
+        }
+        else if (argument == "--tolerance" && i + 1 < argc)
+        {
+            golden_tolerance = atoi(argv[++i]);
+        }
+        else if (argument == "--profile" && i + 1 < argc)
+        {
+            profile_log_path = argv[++i];
+        }
+        else if (argument == "--texture-budget" && i + 1 < argc)
+        {
+            texture_budget_mb = std::max(0, atoi(argv[++i]));
+        }
+        else if (argument == "--upload-budget" && i + 1 < argc)
+        {
+            upload_budget_kb = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            LOG("Ignoring unknown option " << argument);
+        }
+    }
     
-    SDL_GLContext context = SDL_GL_CreateContext(display_window);
-    SDL_GL_MakeCurrent(display_window, context);
+    // Comparing needs something to compare; default to the last frame
+    if (!golden_directory.empty() && capture_frames.empty())
+    {
+        capture_frames.push_back(std::max(frame_limit, 1) - 1);
+    }
     
-#ifdef _WINDOWS
-    glewInit();
-#endif
+    std::sort(capture_frames.begin(), capture_frames.end());
+    if (!capture_frames.empty()) frame_limit = std::max(frame_limit, capture_frames.back() + 1);
     
-    glViewport(VIEWPORT_X, VIEWPORT_Y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+    // Captures are read from the offscreen framebuffer
+    if (!capture_frames.empty()) offscreen = true;
     
-    program.Load(V_SHADER_PATH, F_SHADER_PATH);
+    // Regression runs have to look the same every time
+    if (frame_limit > 0) use_dynamic_resolution = false;
+    if (offscreen && use_software_renderer) headless = true;
+}
+
+void initialise()
+{
+    // Without a display there is no video subsystem, but input events still work
+    SDL_Init((headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO) | SDL_INIT_AUDIO);
+    
+    simulation_clock = new FramePacer(1.0 / FIXED_TIMESTEP);
+    render_pacer = new FramePacer(TARGET_FPS);
+    
+    core_profile = !use_software_renderer && !use_legacy_gl;
+    if (core_profile)
+    {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);   // macOS only hands out core contexts this way
+    }
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+    
+    if (!headless)
+    {
+        display_window = SDL_CreateWindow("Hello, AI!",
+                                          SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                          WINDOW_WIDTH, WINDOW_HEIGHT,
+                                          (use_software_renderer ? 0 : SDL_WINDOW_OPENGL) | (offscreen ? SDL_WINDOW_HIDDEN : 0));
+    }
     
     view_matrix = glm::mat4(1.0f);  // Defines the position (location and orientation) of the camera
     projection_matrix = glm::ortho(-5.0f, 5.0f, -3.75f, 3.75f, -1.0f, 1.0f);  // Defines the characteristics of your camera, such as clip planes, field of view, projection method etc.
     
-    program.SetProjectionMatrix(projection_matrix);
-    program.SetViewMatrix(view_matrix);
+    if (use_software_renderer)
+    {
+        software_renderer = new SoftwareRenderer(render_width, render_height, std::max(1, SDL_GetCPUCount() - 1));
+        software_renderer->SetClearColor(BG_RED, BG_BLUE, BG_GREEN, BG_OPACITY);
+        
+        // Wraps the framebuffer itself, so presenting is a single blit
+        if (!headless)
+        {
+            software_frame = SDL_CreateRGBSurfaceWithFormatFrom((void*) software_renderer->Pixels(), render_width, render_height, 32,
+                                                                software_renderer->Stride() * 4, SDL_PIXELFORMAT_RGBA32);
+        }
+    }
+    else
+    {
+        gl_context = SDL_GL_CreateContext(display_window);
+        if (gl_context == NULL && core_profile)
+        {
+            LOG("No 3.3 core context (" << SDL_GetError() << "); using legacy GL.");
+            SDL_GL_ResetAttributes();
+            SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+            core_profile = false;
+            gl_context = SDL_GL_CreateContext(display_window);
+        }
+        SDL_GL_MakeCurrent(display_window, gl_context);
+        
+        // The offscreen framebuffer brings its own depth buffer
+        int depth_bits = 0;
+        SDL_GL_GetAttribute(SDL_GL_DEPTH_SIZE, &depth_bits);
+        if (depth_bits == 0 && !offscreen && use_materials)
+        {
+            LOG("No depth buffer; blending every material.");
+            use_materials = false;
+        }
+        
+#ifdef _WINDOWS
+        glewExperimental = GL_TRUE;  // core entry points are not listed as extensions
+        glewInit();
+#endif
+        
+        glViewport(VIEWPORT_X, VIEWPORT_Y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+        
+        if (core_profile)
+        {
+            program.Load(V_SHADER_CORE_PATH, F_SHADER_CORE_PATH);
+            RenderDevice::BindUniformBlocks(&program);
+            
+            animated_program.Load(V_SHADER_ANIMATED_PATH, F_SHADER_CORE_PATH);
+            RenderDevice::BindUniformBlocks(&animated_program);
+#ifdef DEBUG
+            debug_program.Load(V_SHADER_DEBUG_CORE_PATH, F_SHADER_DEBUG_CORE_PATH);
+            RenderDevice::BindUniformBlocks(&debug_program);
+#endif
+        }
+        else
+        {
+            program.Load(V_SHADER_PATH, F_SHADER_PATH);
+            
+            program.SetProjectionMatrix(projection_matrix);
+            program.SetViewMatrix(view_matrix);
+#ifdef DEBUG
+            debug_program.Load(V_SHADER_DEBUG_PATH, F_SHADER_DEBUG_PATH);
+#endif
+        }
+#ifdef DEBUG
+        debug_program.SetColor(1.0f, 1.0f, 1.0f, 1.0f);
+#endif
+        
+        glUseProgram(program.programID);
+        
+        glClearColor(BG_RED, BG_BLUE, BG_GREEN, BG_OPACITY);
+        
+        if (offscreen) frame_capture = new FrameCapture(render_width, render_height);
+    }
+    
+    // Leave one core for the main thread; the workers only decode
+    asset_loader = new AssetLoader(std::max(1, SDL_GetCPUCount() - 1), software_renderer, core_profile);
+    asset_loader->SetTextureBudget((size_t) texture_budget_mb * 1024 * 1024);
+    asset_loader->SetUploadBudget((size_t) upload_budget_kb * 1024);
     
-    glUseProgram(program.programID);
+    // The mixer has to be open before any WAV can be decoded into its format
+    Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096);
+    
+    asset_loader->LoadMusic(BGM_FILEPATH, &state.bgm, start_music);
+    asset_loader->LoadSound(JUMP_SFX_FILEPATH, &state.jump_sfx);
     
-    glClearColor(BG_RED, BG_BLUE, BG_GREEN, BG_OPACITY);
+    state.font_texture_id = load_texture(FONT_FILEPATH);
+    hud_text.SetFont(&program, state.font_texture_id);
+    overlay_text.SetFont(&program, state.font_texture_id);
     
+    win_banner  = hud_text.Add("You Win!", 0.5f, -0.05f, glm::vec3(-1.75f, 2.0f, 0.0f), false);
+    lose_banner = hud_text.Add("You Lose...", 0.5f, -0.05f, glm::vec3(-2.0f, 2.0f, 0.0f), false);
     
 //    background
     state.bg = new Entity();
@@ -257,6 +579,9 @@ void initialise()
         state.platforms[i].Update(0, NULL, NULL, NULL, 0, 0, NULL);
     }
     
+    // Platforms never move, so they are drawn from the tile map's baked chunks
+    for (int i = 0; i < PLATFORM_COUNT; i++) level_tiles.SetTile(i, glm::vec2(state.platforms[i].position), state.platforms[i].textureID);
+    
     /**
      George's stuff
      */
@@ -282,6 +607,14 @@ void initialise()
     state.player->animation_time   = 0.0f;
     state.player->animation_cols   = 10;
     state.player->animation_rows   = 10;
+    
+    // The same walk cycles as clips, so the renderer can animate them
+    for (int direction = state.player->LEFT; direction <= state.player->JUMP; direction++)
+    {
+        player_clips[direction] = sprite_animation.AddClip(state.player->walking[direction], state.player->animation_frames,
+                                                           (float) Entity::SECONDS_PER_FRAME, state.player->animation_cols, state.player->animation_rows);
+    }
+    state.player->animation_clip = player_clips[state.player->RIGHT];
     state.player->height= 0.65f;
     state.player->width = 0.5f;
     
@@ -323,6 +656,7 @@ void initialise()
     state.enemies[2].entityType = ENEMY;
     state.enemies[2].ai_type = WALKER;
     state.enemies[2].textureID = vacuum_id;
+    state.enemies[2].palette_row = 1;  // the cooker's green recolour, see PALETTE_VARIANTS
     state.enemies[2].position = glm::vec3(-4.0f, -1.8f, 0.0f);
     state.enemies[2].movement = glm::vec3(0.5f);
     state.enemies[2].speed = 0.4f;
@@ -357,20 +691,14 @@ void initialise()
 //    state.player->height= 0.65f;
 //    state.player->width = 0.5f;
     
-    /**
-     BGM and SFX
-     */
-    Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096);
+    if (software_renderer != NULL) return;
     
-    state.bgm = Mix_LoadMUS("assets/mixkit-alter-ego-481.mp3");
-    Mix_PlayMusic(state.bgm, -1);
-    Mix_VolumeMusic(MIX_MAX_VOLUME / 6.0f);
-    
-    state.jump_sfx = Mix_LoadWAV("assets/mixkit-video-game-spin-jump-2648.wav");
-    
-    // enable blending
+    // enable blending; every texture is premultiplied by the time it is uploaded
     glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    
+    // From here on the context belongs to the render thread
+    SDL_GL_MakeCurrent(display_window, NULL);
 }
 
 void process_input()
@@ -395,12 +723,26 @@ void process_input()
                         game_is_running = false;
                         break;
                         
+                    case SDLK_F3:
+                        show_profiler_overlay = !show_profiler_overlay;
+                        break;
+                        
+                    case SDLK_F4:
+                        show_overdraw = !show_overdraw;
+                        break;
+                        
+#ifdef DEBUG
+                    case SDLK_F5:
+                        show_debug_shapes = !show_debug_shapes;
+                        break;
+                        
+#endif
                     case SDLK_SPACE:
                         // Jump
                         if (state.player->collidedBottom)
                         {
                             state.player->jump = true;
-                            Mix_PlayChannel(-1, state.jump_sfx, 0);
+                            if (state.jump_sfx != NULL) Mix_PlayChannel(-1, state.jump_sfx, 0);
                         }
                         break;
                         
@@ -419,21 +761,25 @@ void process_input()
     {
         state.player->movement.y = 1.0f;
         state.player->animation_indices = state.player->walking[state.player->UP];
+        state.player->animation_clip = player_clips[state.player->UP];
     }
     else if (key_state[SDL_SCANCODE_RETURN])
     {
         state.player->movement.x = -0.0001f;
         state.player->animation_indices = state.player->walking[state.player->DOWN];
+        state.player->animation_clip = player_clips[state.player->DOWN];
     }
     if (key_state[SDL_SCANCODE_LEFT])
     {
         state.player->movement.x = -1.0f;
         state.player->animation_indices = state.player->walking[state.player->LEFT];
+        state.player->animation_clip = player_clips[state.player->LEFT];
     }
     else if (key_state[SDL_SCANCODE_RIGHT])
     {
         state.player->movement.x = 1.0f;
         state.player->animation_indices = state.player->walking[state.player->RIGHT];
+        state.player->animation_clip = player_clips[state.player->RIGHT];
     }
     
     // This makes sure that the player can't move faster diagonally
@@ -443,10 +789,39 @@ void process_input()
     }
 }
 
-void update()
+/**
+ * When the accumulator will next hold a whole FIXED_TIMESTEP.
+ */
+double next_tick_time()
+{
+    return previous_ticks + (FIXED_TIMESTEP - accumulator);
+}
+
+/**
+ * Runs the given number of fixed ticks.
+ */
+void advance_simulation(int ticks)
+{
+    for (int tick = 0; tick < ticks; tick++) {
+        // Update. Notice it's FIXED_TIMESTEP. Not deltaTime
+        state.player->Update(FIXED_TIMESTEP, state.player, state.platforms, state.enemies, PLATFORM_COUNT, ENEMY_COUNT, NULL);
+        
+        for (int i = 0; i < ENEMY_COUNT; i++) state.enemies[i].Update(FIXED_TIMESTEP, state.player, state.platforms, state.enemies, PLATFORM_COUNT, ENEMY_COUNT, state.enemy_bullets);
+        for (int i = 0; i < FIREBALL_COUNT; i++) state.bullets[i].Update(FIXED_TIMESTEP, state.player, state.platforms, state.enemies, PLATFORM_COUNT, ENEMY_COUNT, NULL);
+        
+        simulation_time += FIXED_TIMESTEP;
+    }
+    
+    if (state.enemies[1].collidedBottom)
+    {
+        state.enemies[1].jump = true;
+    }
+}
+
+bool update()
 {
-    float ticks = (float)SDL_GetTicks() / MILLISECONDS_IN_SECOND;
-    float delta_time = ticks - previous_ticks;
+    double ticks = simulation_clock->Now();
+    float delta_time = (float) (ticks - previous_ticks);
     previous_ticks = ticks;
     
     delta_time += accumulator;
@@ -454,53 +829,622 @@ void update()
     if (delta_time < FIXED_TIMESTEP)
     {
         accumulator = delta_time;
-        return;
+        return false;
     }
     
+    int steps = 0;
     while (delta_time >= FIXED_TIMESTEP) {
-        // Update. Notice it's FIXED_TIMESTEP. Not deltaTime
-        state.player->Update(FIXED_TIMESTEP, state.player, state.platforms, state.enemies, PLATFORM_COUNT, ENEMY_COUNT, NULL);
-        
-        for (int i = 0; i < ENEMY_COUNT; i++) state.enemies[i].Update(FIXED_TIMESTEP, state.player, state.platforms, state.enemies, PLATFORM_COUNT, ENEMY_COUNT, state.enemy_bullets);
-        for (int i = 0; i < FIREBALL_COUNT; i++) state.bullets[i].Update(FIXED_TIMESTEP, state.player, state.platforms, state.enemies, PLATFORM_COUNT, ENEMY_COUNT, NULL);
-
-
+        steps++;
         delta_time -= FIXED_TIMESTEP;
     }
     
     accumulator = delta_time;
     
+    advance_simulation(steps);
     
-    if (state.enemies[1].collidedBottom)
+    return true;
+}
+
+void render_if_visible(RenderQueue *queue, Entity *entity, const Bounds2D &view)
+{
+    if (!entity->isActive) return;
+    
+    if (is_visible(*entity, view))
     {
-        state.enemies[1].jump = true;
+        entity->render(queue, &program, core_profile ? &animated_program : &program);
+        cull_stats.drawn++;
     }
+    else
+    {
+        cull_stats.culled++;
+    }
+}
 
+#ifdef DEBUG
+void record_debug_box(DebugDrawList &shapes, const Entity &entity, const glm::vec4 &color)
+{
+    if (!entity.isActive) return;
+    
+    float half_width = entity.width / 2.0f, half_height = entity.height / 2.0f;
+    glm::vec2 center(entity.position.x, entity.position.y);
+    shapes.Box({ center.x - half_width, center.x + half_width, center.y - half_height, center.y + half_height }, color);
+    
+    // Each contact's normal, pointing away from whatever was hit
+    glm::vec2 up(0.0f, half_height), right(half_width, 0.0f);
+    if (entity.collidedBottom) shapes.Line(center - up, center - up + glm::vec2(0.0f, DEBUG_NORMAL_LENGTH), DEBUG_CONTACT_COLOR);
+    if (entity.collidedTop)    shapes.Line(center + up, center + up - glm::vec2(0.0f, DEBUG_NORMAL_LENGTH), DEBUG_CONTACT_COLOR);
+    if (entity.collidedLeft)   shapes.Line(center - right, center - right + glm::vec2(DEBUG_NORMAL_LENGTH, 0.0f), DEBUG_CONTACT_COLOR);
+    if (entity.collidedRight)  shapes.Line(center + right, center + right - glm::vec2(DEBUG_NORMAL_LENGTH, 0.0f), DEBUG_CONTACT_COLOR);
 }
 
+/**
+ * Collision boxes as the simulation sees them this tick, the tile map's
+ * chunk grid and every contact normal, for the render thread to draw on
+ * top of the frame.
+ */
+void record_debug_shapes(DebugDrawList &shapes)
+{
+    std::vector<Bounds2D> cells;
+    level_tiles.ChunkCells(cells);
+    for (const Bounds2D &cell : cells) shapes.Box(cell, DEBUG_CHUNK_COLOR);
+    
+    for (int i = 0; i < PLATFORM_COUNT; i++) record_debug_box(shapes, state.platforms[i], DEBUG_PLATFORM_COLOR);
+    for (int i = 0; i < ENEMY_COUNT; i++) record_debug_box(shapes, state.enemies[i], DEBUG_ENEMY_COLOR);
+    for (int i = 0; i < FIREBALL_COUNT; i++) record_debug_box(shapes, state.bullets[i], DEBUG_BULLET_COLOR);
+    record_debug_box(shapes, *state.player, DEBUG_PLAYER_COLOR);
+}
+#endif
+
+/**
+ * Runs on the simulation thread: records this tick's draws into a snapshot
+ * and hands it to the render thread. No GL calls happen here.
+ */
 void render()
 {
-    glClear(GL_COLOR_BUFFER_BIT);
+    RenderSnapshot &frame = snapshots.WriteBuffer();
+    RenderQueue *queue = &frame.queue;
     
-    state.bg->renderbg(&program);
+    queue->Clear();
+    frame.view_matrix = view_matrix;
+    frame.projection_matrix = projection_matrix;
+    queue->SetAnimation(&sprite_animation, (float) simulation_time);
     
-    for (int i = 0; i < PLATFORM_COUNT; i++) state.platforms[i].render(&program);
-    state.player->render(&program);
-    for (int i = 0; i < ENEMY_COUNT; i++) state.enemies[i].render(&program);
-    if(state.player->isActive && areEnemiesActive(state.enemies) == false) {
-            DrawText(&program, load_texture("assets/font1.png"), "You Win!", 0.5, -0.05, glm::vec3(-1.75, 2, 0));
-            
+    state.bg->renderbg(queue, &program);
+    
+    // Culling: nothing outside the camera gets as far as the render queue
+    Bounds2D view = view_bounds(projection_matrix, view_matrix);
+#ifdef DEBUG
+    CullStats previous_stats = cull_stats;
+#endif
+    cull_stats = CullStats();
+    
+    level_tiles.Submit(queue, &program, LAYER_WORLD, view, &cull_stats);
+    
+    render_if_visible(queue, state.player, view);
+    for (int i = 0; i < ENEMY_COUNT; i++) render_if_visible(queue, &state.enemies[i], view);
+    
+#ifdef DEBUG
+    if (cull_stats.drawn != previous_stats.drawn || cull_stats.culled != previous_stats.culled)
+    {
+        LOG("Culling: " << cull_stats.drawn << " drawn, " << cull_stats.culled << " culled");
+    }
+#endif
+    
+    hud_text.SetVisible(win_banner, state.player->isActive && areEnemiesActive(state.enemies) == false);
+    hud_text.SetVisible(lose_banner, state.player->isActive == false && areEnemiesActive(state.enemies));
+    hud_text.Submit(queue);
+    hud_text.EndFrame();
+    
+#ifdef DEBUG
+    frame.debug_shapes.Clear();
+    if (show_debug_shapes) record_debug_shapes(frame.debug_shapes);
+#endif
+    
+    snapshots.Publish();
+}
+
+// What the render device asks the asset loader about each texture it draws
+Material texture_material(GLuint textureID)
+{
+    return asset_loader->TextureMaterial(textureID);
+}
+
+GLuint texture_palette(GLuint textureID, int *rows)
+{
+    return asset_loader->TexturePalette(textureID, rows);
+}
+
+bool texture_used(GLuint textureID)
+{
+    return asset_loader->TextureUsed(textureID);
+}
+
+/**
+ * The layer cache matches the target the world is drawn into, so it is
+ * rebuilt whenever the resolution scale moves.
+ */
+void create_layer_cache(int width, int height)
+{
+    delete layer_cache;
+    layer_cache = NULL;
+    if (!use_layer_cache) return;
+    
+    layer_cache = new LayerCache(width, height, LAYER_CACHE_MARGIN * width / render_width);
+    if (!layer_cache->IsComplete())
+    {
+        LOG("Unable to create the layer cache; drawing every layer every frame.");
+        delete layer_cache;
+        layer_cache = NULL;
+        use_layer_cache = false;
+    }
+}
+
+/**
+ * GL objects that belong to whichever thread draws; created and destroyed
+ * with the context current there.
+ */
+void create_render_resources()
+{
+    if (software_renderer != NULL) return;
+    
+    render_device = new RenderDevice(core_profile);
+    render_device->SetMaterialLookup(texture_material);
+    render_device->SetPaletteLookup(texture_palette);
+    render_device->SetTextureUse(texture_used);
+    render_device->EnableMaterials(use_materials);
+    
+    // The simulation, render and asset threads already have a core each
+    if (render_thread_count < 0) render_thread_count = std::max(0, SDL_GetCPUCount() - 3);
+    if (render_thread_count > 0)
+    {
+        render_workers = new ThreadPool(render_thread_count);
+        render_device->SetWorkers(render_workers);
+    }
+    
+#ifdef DEBUG
+    debug_draw = new DebugDraw(core_profile);
+#endif
+    
+    gpu_profiler = new GpuProfiler(std::vector<std::string>(RENDER_PASS_NAMES, RENDER_PASS_NAMES + RENDER_PASS_COUNT));
+    if (!gpu_profiler->HasTimerQueries()) LOG("No timer queries on this driver; profiling CPU time only.");
+    if (profile_log_path != NULL && !gpu_profiler->OpenLog(profile_log_path)) LOG("Unable to open " << profile_log_path << ".");
+    
+    create_layer_cache(render_width, render_height);
+    
+    if (use_dynamic_resolution || fixed_resolution_scale < 1.0f)
+    {
+        scaled_target = new ScaledTarget(render_width, render_height);
+        if (!scaled_target->IsComplete())
+        {
+            LOG("Unable to create the scaled framebuffer; drawing at full resolution.");
+            delete scaled_target;
+            scaled_target = NULL;
         }
-    else if (state.player->isActive ==  false && areEnemiesActive(state.enemies)) {
-            DrawText(&program, load_texture("assets/font1.png"), "You Lose...", 0.5, -0.05, glm::vec3(-2, 2, 0));
+    }
+    if (scaled_target != NULL && use_dynamic_resolution) resolution_scaler = new ResolutionScaler(frame_budget_ms);
+    measured_frame = -1;
+}
+
+void destroy_render_resources()
+{
+    delete resolution_scaler;
+    resolution_scaler = NULL;
+    delete scaled_target;
+    scaled_target = NULL;
+    delete layer_cache;
+    layer_cache = NULL;
+    delete gpu_profiler;
+    gpu_profiler = NULL;
+#ifdef DEBUG
+    delete debug_draw;
+    debug_draw = NULL;
+#endif
+    delete render_device;
+    render_device = NULL;
+    delete render_workers;
+    render_workers = NULL;
+}
+
+/**
+ * Adds the latest pass timings to the top left of the frame. Runs on the
+ * render thread, which owns the snapshot until the next Acquire().
+ */
+void draw_profiler_overlay(RenderSnapshot &frame)
+{
+    Bounds2D view = view_bounds(frame.projection_matrix, frame.view_matrix);
+    glm::vec3 cursor(view.left + PROFILER_TEXT_SIZE, view.top - PROFILER_TEXT_SIZE, 0.0f);
+    char line[64];
+    
+    snprintf(line, sizeof(line), "frame %d cpu %.2f ms", gpu_profiler->LatestFrame(), gpu_profiler->LatestFrameCpuMilliseconds());
+    overlay_text.Draw(&frame.queue, line, PROFILER_TEXT_SIZE, -0.05f, cursor);
+    
+    for (const PassTiming &timing : gpu_profiler->Latest())
+    {
+        cursor.y -= PROFILER_TEXT_SIZE * 1.2f;
+        if (!timing.drawn) snprintf(line, sizeof(line), "%-10s -", timing.name.c_str());
+        else if (!gpu_profiler->HasTimerQueries()) snprintf(line, sizeof(line), "%-10s gpu n/a cpu %.2f", timing.name.c_str(), timing.cpuMilliseconds);
+        else snprintf(line, sizeof(line), "%-10s gpu %.2f cpu %.2f", timing.name.c_str(), timing.gpuMilliseconds, timing.cpuMilliseconds);
+        overlay_text.Draw(&frame.queue, line, PROFILER_TEXT_SIZE, -0.05f, cursor);
+    }
+    
+    if (scaled_target != NULL)
+    {
+        cursor.y -= PROFILER_TEXT_SIZE * 1.2f;
+        snprintf(line, sizeof(line), "scale %.3f %dx%d", scaled_target->Scale(), scaled_target->ScaledWidth(), scaled_target->ScaledHeight());
+        overlay_text.Draw(&frame.queue, line, PROFILER_TEXT_SIZE, -0.05f, cursor);
+    }
+    
+    overlay_text.EndFrame();
+}
+
+/**
+ * Texture uploads are invisible to the layer cache's signature, so a cache
+ * drawn with a placeholder has to be redrawn once the real pixels are in.
+ */
+void pump_textures()
+{
+    if (asset_loader->PumpTextures() > 0 && layer_cache != NULL) layer_cache->Invalidate();
+}
+
+void bind_frame_target()
+{
+    if (frame_capture != NULL)
+    {
+        frame_capture->Bind();
+    }
+    else
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(VIEWPORT_X, VIEWPORT_Y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+    }
+}
+
+void clear_target(bool overdraw)
+{
+    // Overdraw counts up from black
+    if (overdraw) glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (overdraw) glClearColor(BG_RED, BG_BLUE, BG_GREEN, BG_OPACITY);
+}
+
+/**
+ * Brings the scaled target up to the scale in force, fixed or from the
+ * scaler. False when the world is drawn at full resolution this frame.
+ */
+bool apply_resolution_scale()
+{
+    if (scaled_target == NULL) return false;
+    
+    float scale = resolution_scaler != NULL ? resolution_scaler->Scale() : fixed_resolution_scale;
+    if (scale != scaled_target->Scale())
+    {
+        scaled_target->SetScale(scale);
+        create_layer_cache(scaled_target->ScaledWidth(), scaled_target->ScaledHeight());
+    }
+    return scale < 1.0f;
+}
+
+/**
+ * Feeds the scaler each frame's GPU time as it comes in, a couple of
+ * frames late; CPU time where there are no timer queries.
+ */
+void measure_frame()
+{
+    if (resolution_scaler == NULL || gpu_profiler->LatestFrame() == measured_frame) return;
+    measured_frame = gpu_profiler->LatestFrame();
+    
+    double milliseconds = 0;
+    if (gpu_profiler->HasTimerQueries())
+    {
+        for (const PassTiming &timing : gpu_profiler->Latest()) milliseconds += timing.gpuMilliseconds;
+    }
+    else
+    {
+        milliseconds = gpu_profiler->LatestFrameCpuMilliseconds();
+    }
+    
+    if (resolution_scaler->AddFrame(milliseconds))
+    {
+        LOG("Resolution scale " << resolution_scaler->Scale() << " (" << resolution_scaler->SmoothedMilliseconds() << " ms against a "
+            << resolution_scaler->BudgetMilliseconds() << " ms budget)");
+    }
+}
+
+/**
+ * Draws a snapshot with whichever backend is active, into the offscreen
+ * framebuffer when there is one. The static layers come from the layer
+ * cache when there is one, redrawn first if they have to be. At a
+ * resolution scale below 1 everything but the UI goes through the scaled
+ * target first.
+ */
+void draw_snapshot(RenderSnapshot &frame)
+{
+    if (software_renderer != NULL)
+    {
+        frame.queue.Sort();
+        software_renderer->Draw(frame.queue, frame.projection_matrix, frame.view_matrix);
+        return;
+    }
+    
+    gpu_profiler->BeginFrame();
+    if (show_profiler_overlay) draw_profiler_overlay(frame);
+    frame.queue.Sort();
+    
+    // The cached layers have to be redrawn the other way too
+    bool overdraw = show_overdraw;
+    if (overdraw != render_device->OverdrawView())
+    {
+        render_device->SetOverdrawView(overdraw);
+        if (layer_cache != NULL) layer_cache->Invalidate();
+    }
+    
+    bool scaled = apply_resolution_scale();
+    RenderLayer world_last = scaled ? LAYER_ACTORS : LAYER_UI;
+    
+    if (layer_cache != NULL) layer_cache->Update(frame.queue, *render_device, &program, gpu_profiler, frame.projection_matrix, frame.view_matrix);
+    if (scaled) scaled_target->Bind();
+    else bind_frame_target();
+    
+    render_device->SetCamera(&program, frame.projection_matrix, frame.view_matrix);
+    render_device->SetAnimation(&animated_program, sprite_animation, frame.queue.AnimationTime());
+    
+    clear_target(overdraw);
+    if (layer_cache != NULL)
+    {
+        layer_cache->Composite(*render_device, &program);
+        frame.queue.Execute(*render_device, gpu_profiler, LAYER_ACTORS, world_last);
+    }
+    else
+    {
+        frame.queue.Execute(*render_device, gpu_profiler, LAYER_BACKGROUND, world_last);
+    }
+    
+    if (scaled)
+    {
+        bind_frame_target();
+        clear_target(overdraw);
+        scaled_target->Present(*render_device, &program, view_bounds(frame.projection_matrix, frame.view_matrix));
+        frame.queue.Execute(*render_device, gpu_profiler, LAYER_UI, LAYER_UI);
+    }
+    
+#ifdef DEBUG
+    debug_draw->Draw(frame.debug_shapes, *render_device, &debug_program, frame.projection_matrix, frame.view_matrix);
+#endif
+    
+    render_device->EndFrame();
+    asset_loader->EndFrame();
+    gpu_profiler->EndFrame();
+    measure_frame();
+}
+
+/**
+ * Starts reading back the frame just drawn. The GL path finishes it a few
+ * frames later in collect_captures(); the software framebuffer is already
+ * in memory.
+ */
+void capture_frame(int frame)
+{
+    if (software_renderer == NULL)
+    {
+        frame_capture->Readback(frame);
+        return;
+    }
+    
+    captured_frames.emplace_back();
+    CapturedFrame &captured = captured_frames.back();
+    captured.frame = frame;
+    captured.image.width = render_width;
+    captured.image.height = render_height;
+    captured.image.pixels.resize(render_width * render_height * 4);
+    for (int y = 0; y < render_height; y++)
+    {
+        memcpy(&captured.image.pixels[y * render_width * 4], software_renderer->Pixels() + y * software_renderer->Stride(), render_width * 4);
+    }
+}
+
+std::string capture_filename(const std::string &directory, int frame, const char *suffix)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/frame_%04d%s.png", frame, suffix);
+    return directory + name;
+}
+
+/**
+ * Saves finished captures and checks them against the golden images.
+ */
+void collect_captures(bool drain)
+{
+    if (frame_capture != NULL) frame_capture->Collect(captured_frames, drain);
+    
+    for (const CapturedFrame &captured : captured_frames)
+    {
+        std::string path = capture_filename(capture_directory, captured.frame, "");
+        if (!write_png(path, captured.image)) LOG("Unable to write " << path << ".");
+        
+        if (golden_directory.empty()) continue;
+        
+        Image golden;
+        std::string golden_path = capture_filename(golden_directory, captured.frame, "");
+        if (!load_image(golden_path, &golden))
+        {
+            LOG("FAIL frame " << captured.frame << ": no golden image at " << golden_path << ".");
+            golden_failures++;
+            continue;
+        }
+        if (golden.width != captured.image.width || golden.height != captured.image.height)
+        {
+            LOG("FAIL frame " << captured.frame << ": golden image is " << golden.width << "x" << golden.height
+                << ", capture is " << captured.image.width << "x" << captured.image.height << ".");
+            golden_failures++;
+            continue;
         }
         
+        ImageDifference difference = compare_images(captured.image, golden, golden_tolerance);
+        if (difference.pixelsOverTolerance > 0)
+        {
+            LOG("FAIL frame " << captured.frame << ": " << difference.pixelsOverTolerance << " pixels differ by more than "
+                << golden_tolerance << " (worst " << difference.maxChannelDifference << ").");
+            write_png(capture_filename(capture_directory, captured.frame, "_diff"), difference_image(captured.image, golden, golden_tolerance));
+            golden_failures++;
+        }
+        else
+        {
+            LOG("PASS frame " << captured.frame << " (worst difference " << difference.maxChannelDifference << ").");
+        }
+    }
+    captured_frames.clear();
+}
+
+void present_frame()
+{
+    if (offscreen) return;
     
-    SDL_GL_SwapWindow(display_window);
+    if (software_renderer == NULL)
+    {
+        SDL_GL_SwapWindow(display_window);
+    }
+    else if (!headless)
+    {
+        SDL_BlitSurface(software_frame, NULL, SDL_GetWindowSurface(display_window), NULL);
+        SDL_UpdateWindowSurface(display_window);
+    }
+}
+
+/**
+ * The render thread owns the GL context. It uploads whatever the asset
+ * loader has finished, draws the newest snapshot and presents it, so a
+ * swap that blocks on vsync only ever stalls this thread.
+ */
+void render_thread_main()
+{
+    // The software renderer has no swap to wait on, so it is always paced here
+    VsyncMode vsync = VSYNC_OFF;
+    if (software_renderer == NULL)
+    {
+        SDL_GL_MakeCurrent(display_window, gl_context);
+        vsync = set_vsync(offscreen ? VSYNC_OFF : REQUESTED_VSYNC);
+    }
+    create_render_resources();
+#ifdef DEBUG
+    double next_report = render_pacer->Now() + TIMING_REPORT_INTERVAL;
+#endif
+    
+    while (render_thread_running)
+    {
+        pump_textures();
+        
+        if (!snapshots.Acquire())
+        {
+            // Nothing new from the simulation yet; sleep a frame slot rather than poll
+            render_pacer->WaitForNextFrame();
+            continue;
+        }
+        
+        draw_snapshot(snapshots.ReadBuffer());
+        
+        // With vsync the swap itself waits for the display
+        if (vsync == VSYNC_OFF) render_pacer->WaitForNextFrame();
+        present_frame();
+        render_pacer->FrameCompleted();
+        
+#ifdef DEBUG
+        if (render_pacer->Now() >= next_report)
+        {
+            FrameTimingStats timing = render_pacer->Stats();
+            LOG("Frame time: " << timing.meanSeconds * 1000.0 << " ms mean, " << timing.jitterSeconds * 1000.0 << " ms jitter, "
+                << timing.minSeconds * 1000.0 << "-" << timing.maxSeconds * 1000.0 << " ms, " << timing.missedFrames << " missed");
+            if (resolution_scaler != NULL)
+            {
+                std::stringstream levels;
+                for (int level = 0; level < ResolutionScaler::LEVELS; level++)
+                {
+                    levels << " " << ResolutionScaler::LevelScale(level) << ": " << resolution_scaler->FramesAtLevel(level);
+                }
+                LOG("Resolution scale: " << resolution_scaler->Scale() << ", " << resolution_scaler->Changes() << " changes; frames at" << levels.str());
+            }
+            if (software_renderer == NULL)
+            {
+                LOG("Textures: " << asset_loader->ResidentBytes() / 1024 << " KB resident, " << asset_loader->Evictions() << " evictions, "
+                    << asset_loader->Reloads() << " reloads");
+            }
+            next_report += TIMING_REPORT_INTERVAL;
+        }
+#endif
+    }
+    
+    destroy_render_resources();
+    if (software_renderer == NULL) SDL_GL_MakeCurrent(display_window, NULL);
+}
+
+/**
+ * Regression runs: everything on this thread, in lock step. All assets are
+ * in before the first frame and each frame is exactly one tick, so frame N
+ * looks the same on every run and every machine.
+ */
+void run_fixed_frames()
+{
+    if (software_renderer == NULL) SDL_GL_MakeCurrent(display_window, gl_context);
+    create_render_resources();
+    
+    while (asset_loader->PendingCount() > 0)
+    {
+        pump_textures();
+        asset_loader->PumpAudio();
+        SDL_Delay(1);
+    }
+    
+    if (!capture_frames.empty())
+    {
+#ifdef _WINDOWS
+        _mkdir(capture_directory.c_str());
+#else
+        mkdir(capture_directory.c_str(), 0755);
+#endif
+    }
+    
+    size_t next_capture = 0;
+    for (int frame = 0; frame < frame_limit && game_is_running; frame++)
+    {
+        process_input();
+        advance_simulation(1);
+        render();
+        
+        snapshots.Acquire();
+        draw_snapshot(snapshots.ReadBuffer());
+        
+        if (next_capture < capture_frames.size() && capture_frames[next_capture] == frame)
+        {
+            capture_frame(frame);
+            while (next_capture < capture_frames.size() && capture_frames[next_capture] == frame) next_capture++;
+        }
+        collect_captures(false);
+        
+        present_frame();
+    }
+    
+    collect_captures(true);
+    
+    destroy_render_resources();
+    if (software_renderer == NULL) SDL_GL_MakeCurrent(display_window, NULL);
 }
 
 void shutdown()
 {    
+    render_thread_running = false;
+    if (render_thread.joinable()) render_thread.join();
+    
+    delete render_pacer;
+    delete simulation_clock;
+    
+    // The loader joins its workers, frees anything that finished but was
+    // never pumped and deletes its textures, which needs the context back
+    if (software_renderer == NULL) SDL_GL_MakeCurrent(display_window, gl_context);
+    delete asset_loader;
+    delete frame_capture;
+    
+    if (software_frame != NULL) SDL_FreeSurface(software_frame);
+    delete software_renderer;
+    
     SDL_Quit();
     
     delete [] state.platforms;
@@ -515,13 +1459,30 @@ void shutdown()
  */
 int main(int argc, char* argv[])
 {
+    parse_arguments(argc, argv);
     initialise();
     
+    if (frame_limit > 0)
+    {
+        run_fixed_frames();
+        shutdown();
+        
+        // Non-zero when any frame failed its golden comparison
+        return golden_failures > 0 ? 1 : 0;
+    }
+    
+    render_thread_running = true;
+    render_thread = std::thread(render_thread_main);
+    
     while (game_is_running)
     {
         process_input();
-        update();
-        render();
+        asset_loader->PumpAudio();
+        
+        // Only a tick that moved the simulation produces a new snapshot;
+        // otherwise sleep until the next one is due instead of spinning
+        if (update()) render();
+        else simulation_clock->WaitUntil(next_tick_time());
     }
     
     shutdown();
@@ -1,5 +1,7 @@
 uniform vec4 color;
 
+varying vec4 colorVar;
+
 void main() {
-    gl_FragColor = color;
+    gl_FragColor = color * colorVar;
 }
@@ -0,0 +1,10 @@
+#version 330 core
+
+uniform vec4 color;
+in vec4 colorVar;
+
+out vec4 fragColor;
+
+void main() {
+    fragColor = color * colorVar;
+}
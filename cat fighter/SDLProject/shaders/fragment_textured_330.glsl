@@ -0,0 +1,27 @@
+#version 330 core
+
+uniform sampler2D diffuse;
+uniform sampler2D palette;   // rows of 256 colours, for indexed textures
+uniform float paletteRows;   // 0 when the texture holds its colours directly
+uniform float alphaCutoff;   // 0.5 for cutout materials, 0 otherwise
+uniform float overdraw;      // above 0 only in the overdraw view
+in vec2 texCoordVar;
+
+out vec4 fragColor;
+
+void main() {
+    // u carries the palette row as 2 * row + u
+    float row = floor(texCoordVar.x * 0.5);
+    vec2 uv = vec2(texCoordVar.x - 2.0 * row, texCoordVar.y);
+
+    vec4 color = texture(diffuse, uv);
+    if (paletteRows > 0.0)
+    {
+        float index = floor(color.r * 255.0 + 0.5);
+        row = clamp(row, 0.0, paletteRows - 1.0);
+        color = texture(palette, vec2((index + 0.5) / 256.0, (row + 0.5) / paletteRows));
+    }
+
+    if (color.a < alphaCutoff) discard;
+    fragColor = overdraw > 0.0 ? vec4(overdraw) : color;
+}
@@ -1,11 +1,15 @@
 attribute vec4 position;
+attribute vec4 vertexColor;
 
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
+varying vec4 colorVar;
+
 void main()
 {
 	vec4 p = viewMatrix * modelMatrix  * position;
+	colorVar = vertexColor;
 	gl_Position = projectionMatrix * p;
 }
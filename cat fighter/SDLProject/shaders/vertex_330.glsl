@@ -0,0 +1,18 @@
+#version 330 core
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec4 vertexColor;
+
+layout(std140) uniform Camera {
+    mat4 viewProjection;
+};
+
+uniform mat4 modelMatrix;
+
+out vec4 colorVar;
+
+void main()
+{
+    colorVar = vertexColor;
+    gl_Position = viewProjection * modelMatrix * position;
+}
@@ -0,0 +1,39 @@
+#version 330 core
+
+// texCoord packs the sprite's animation instead of a texture coordinate:
+// x = 2 * clip + corner u, y = 2 * phase + corner v, corners being 0 or 1
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 texCoord;
+
+layout(std140) uniform Camera {
+    mat4 viewProjection;
+};
+
+// Filled from SpriteAnimation::Pack()
+layout(std140) uniform Clips {
+    vec4 clips[64];    // per clip: (first, frameCount, fps, 0), (cols, rows, 0, 0)
+    vec4 frames[64];   // four frame indices each
+};
+
+uniform mat4 modelMatrix;
+uniform float time;
+
+out vec2 texCoordVar;
+
+void main()
+{
+    vec2 corner = mod(texCoord, 2.0);
+    int clip = int(texCoord.x * 0.5);
+    float phase = floor(texCoord.y * 0.5);
+
+    vec4 timing = clips[clip * 2];
+    vec2 grid = clips[clip * 2 + 1].xy;
+
+    int step = int(mod(floor(time * timing.z) + phase, timing.y));
+    int index = int(timing.x) + step;
+    float frame = frames[index / 4][index % 4];
+
+    vec2 cell = vec2(mod(frame, grid.x), floor(frame / grid.x));
+    texCoordVar = (cell + corner) / grid;
+    gl_Position = viewProjection * modelMatrix * position;
+}
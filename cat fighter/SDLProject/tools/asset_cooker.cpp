@@ -0,0 +1,623 @@
+//
+//  asset_cooker.cpp
+//  SDLProject
+//
+//  Copyright © 2022 ctg. All rights reserved.
+//
+//  Offline step that turns every PNG/JPEG in the assets folder into a cooked
+//  texture (see CookedTexture.h): premultiplied RGBA8, resampled down to the
+//  largest size it is ever drawn at, with a mip chain and filtering chosen
+//  per asset. Sprites marked indexed are stored as 8-bit palette indices
+//  plus a palette instead, with a row for every recoloured variant, and
+//  ones marked for compression as BC1/BC3/BC7 blocks. Build and run from
+//  the SDLProject folder:
+//
+//      c++ -std=c++14 -O2 -I. tools/asset_cooker.cpp CookedTexture.cpp BlockCompression.cpp -o asset_cooker
+//      ./asset_cooker assets
+//
+
+#define STB_IMAGE_IMPLEMENTATION
+#define LOG(argument) std::cout << argument << '\n'
+
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "stb_image.h"
+#include "BlockCompression.h"
+#include "CookedTexture.h"
+
+/**
+ IMPORT SETTINGS
+ */
+// The camera shows 10 x 7.5 world units in a 640 x 480 window
+const float PIXELS_PER_UNIT = 64.0f;
+
+/**
+ * How an image is used on screen. The largest footprint is the quad size in
+ * world units times the atlas grid, so a texture never keeps more texels than
+ * it can ever show. Atlases stay nearest-filtered without mips so frames
+ * never bleed into each other.
+ *
+ * Indexed sprites are looked up through their palette in the fragment
+ * shader, which only works on unfiltered indices, so they are always
+ * nearest-filtered without mips whatever the other columns say. Images of
+ * more than COOKED_PALETTE_SIZE colours are reduced to that many.
+ *
+ * Everything else can be stored as 4x4 blocks (see BlockCompression.h),
+ * every level of it, for a quarter or an eighth of the memory. That suits
+ * filtered images: BC1 for opaque ones, BC3 where there is alpha, and BC7
+ * where BC3 visibly bands, bearing in mind macOS has no BC7 and decodes it
+ * back to RGBA8 at load. The BC7 encoder only knows mode 6, which shares
+ * one line between colour and alpha and so loses to BC3 along soft alpha
+ * edges; an image asking for BC7 is measured both ways and cooked as BC3
+ * unless BC7 actually comes out ahead. Atlases drawn nearest stay RGBA8,
+ * since block artefacts show up plainly on hard-edged pixel art.
+ */
+struct ImportSettings {
+    const char *name;
+    float quadWidth, quadHeight;   // world units the texture (or one atlas cell) is drawn at
+    int cols, rows;                // atlas grid, 1 x 1 for plain sprites
+    bool linear;
+    bool mipmaps;
+    bool indexed;
+    CookedPixelFormat compression;   // COOKED_RGBA8 for none
+};
+
+const ImportSettings IMPORT_SETTINGS[] = {
+    // name                            quad         grid     linear mipmaps indexed compression
+    { "Aibg.jpg",                      10.0f, 10.0f,  1,  1, true,  true,  false, COOKED_BC1   },   // renderbg quad
+    { "stone.png",                     1.0f,  1.0f,   1,  1, true,  true,  false, COOKED_BC1   },
+    { "yarn-removebg-preview.png",     1.0f,  1.0f,   1,  1, true,  true,  false, COOKED_BC7   },   // soft shading
+    { "vacuum-removebg-preview.png",   1.0f,  1.0f,   1,  1, false, false, true,  COOKED_RGBA8 },
+    { "cat_fighter_sprite1.png",       1.0f,  1.0f,  10, 10, false, false, true,  COOKED_RGBA8 },
+    { "catsheet.png",                  1.0f,  1.0f,  10, 10, false, false, false, COOKED_RGBA8 },
+    { "george_0.png",                  1.0f,  1.0f,   4,  4, false, false, true,  COOKED_RGBA8 },   // already colormapped
+    { "font1.png",                     0.5f,  0.5f,  16, 16, false, false, false, COOKED_RGBA8 },   // DrawText size 0.5
+};
+
+// Anything not listed is assumed to be a plain sprite on a one-unit quad, and
+// left uncompressed until someone has looked at what the blocks do to it
+const ImportSettings DEFAULT_IMPORT_SETTINGS = { "", 1.0f, 1.0f, 1, 1, true, true, false, COOKED_RGBA8 };
+
+/**
+ * Recoloured variants of indexed sprites. Each adds one palette row after
+ * the source colours (row 0), in the order listed here, so a variant costs
+ * COOKED_PALETTE_SIZE colours instead of another copy of the texture.
+ */
+struct PaletteVariant {
+    const char *name;
+    float hueDegrees;   // turned about the grey axis
+    float brightness;
+};
+
+const PaletteVariant PALETTE_VARIANTS[] = {
+    // name                            hue      brightness
+    { "vacuum-removebg-preview.png",   120.0f,  1.0f  },   // row 1
+    { "vacuum-removebg-preview.png",   240.0f,  0.85f },   // row 2
+};
+
+static const ImportSettings &import_settings_for(const std::string &name)
+{
+    for (const ImportSettings &settings : IMPORT_SETTINGS)
+    {
+        if (name == settings.name) return settings;
+    }
+    return DEFAULT_IMPORT_SETTINGS;
+}
+
+static std::vector<PaletteVariant> palette_variants_for(const std::string &name)
+{
+    std::vector<PaletteVariant> variants;
+    for (const PaletteVariant &variant : PALETTE_VARIANTS)
+    {
+        if (name == variant.name) variants.push_back(variant);
+    }
+    return variants;
+}
+
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t hash_import_settings(const ImportSettings &settings)
+{
+    // FNV-1a over the fields that change the cooked output
+    float values[] = { settings.quadWidth, settings.quadHeight, (float) settings.cols, (float) settings.rows,
+                       settings.linear ? 1.0f : 0.0f, settings.mipmaps ? 1.0f : 0.0f, PIXELS_PER_UNIT,
+                       settings.indexed ? 1.0f : 0.0f, (float) settings.compression };
+    uint32_t hash = hash_bytes(2166136261u, values, sizeof(values));
+
+    for (const PaletteVariant &variant : palette_variants_for(settings.name))
+    {
+        float recolor[] = { variant.hueDegrees, variant.brightness };
+        hash = hash_bytes(hash, recolor, sizeof(recolor));
+    }
+    return hash;
+}
+
+/**
+ HELPERS
+ */
+static bool has_image_extension(const std::string &name)
+{
+    const char *extensions[] = { ".png", ".jpg", ".jpeg" };
+    for (const char *extension : extensions)
+    {
+        size_t length = strlen(extension);
+        if (name.size() > length && name.compare(name.size() - length, length, extension) == 0) return true;
+    }
+    return false;
+}
+
+static bool is_up_to_date(const std::string &source, const std::string &cooked, uint32_t importHash)
+{
+    if (!cooked_texture_is_current(source, cooked)) return false;
+
+    // Files from an older cooker version or different settings are rebuilt
+    MappedTexture texture;
+    if (!map_cooked_texture(cooked, &texture)) return false;
+    bool same_settings = texture.header->importHash == importHash;
+    unmap_cooked_texture(&texture);
+    return same_settings;
+}
+
+/**
+ * Area-averaging resample for shrinking only: every destination texel is the
+ * coverage-weighted mean of the source texels under it. Works on
+ * premultiplied data, so transparent edges don't darken.
+ */
+static CookedLevelData resample(const CookedLevelData &source, uint32_t width, uint32_t height)
+{
+    CookedLevelData level;
+    level.width  = width;
+    level.height = height;
+    level.pixels.resize(width * height * 4);
+
+    float scale_x = (float) source.width  / width;
+    float scale_y = (float) source.height / height;
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        float top = y * scale_y, bottom = (y + 1) * scale_y;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            float left = x * scale_x, right = (x + 1) * scale_x;
+            float sum[4] = { 0, 0, 0, 0 };
+            float total = 0;
+
+            for (uint32_t sy = (uint32_t) top; sy < std::min((uint32_t) std::ceil(bottom), source.height); sy++)
+            {
+                float weight_y = std::min(bottom, sy + 1.0f) - std::max(top, (float) sy);
+                for (uint32_t sx = (uint32_t) left; sx < std::min((uint32_t) std::ceil(right), source.width); sx++)
+                {
+                    float weight = weight_y * (std::min(right, sx + 1.0f) - std::max(left, (float) sx));
+                    const unsigned char *texel = &source.pixels[(sy * source.width + sx) * 4];
+                    for (int channel = 0; channel < 4; channel++) sum[channel] += texel[channel] * weight;
+                    total += weight;
+                }
+            }
+
+            for (int channel = 0; channel < 4; channel++)
+            {
+                level.pixels[(y * width + x) * 4 + channel] = (unsigned char) std::min(255.0f, sum[channel] / total + 0.5f);
+            }
+        }
+    }
+
+    return level;
+}
+
+/**
+ * Box-filters a level down to half size. Odd edges reuse their last
+ * row/column so every level down to 1x1 stays well defined.
+ */
+static CookedLevelData downsample(const CookedLevelData &source)
+{
+    CookedLevelData level;
+    level.width  = source.width  > 1 ? source.width  / 2 : 1;
+    level.height = source.height > 1 ? source.height / 2 : 1;
+    level.pixels.resize(level.width * level.height * 4);
+
+    for (uint32_t y = 0; y < level.height; y++)
+    {
+        uint32_t y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+        for (uint32_t x = 0; x < level.width; x++)
+        {
+            uint32_t x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+            for (int channel = 0; channel < 4; channel++)
+            {
+                unsigned sum = source.pixels[(y0 * source.width + x0) * 4 + channel]
+                             + source.pixels[(y0 * source.width + x1) * 4 + channel]
+                             + source.pixels[(y1 * source.width + x0) * 4 + channel]
+                             + source.pixels[(y1 * source.width + x1) * 4 + channel];
+                level.pixels[(y * level.width + x) * 4 + channel] = (unsigned char) ((sum + 2) / 4);
+            }
+        }
+    }
+
+    return level;
+}
+
+/**
+ * Largest size worth keeping along one axis: the on-screen footprint, rounded
+ * to whole atlas cells, and never bigger than the source.
+ */
+static uint32_t target_extent(uint32_t source, float quadSize, int cells)
+{
+    uint32_t cell = (uint32_t) std::ceil(quadSize * PIXELS_PER_UNIT);
+    uint32_t footprint = cell * cells;
+    return footprint < source ? footprint : source;
+}
+
+static size_t level_bytes(const std::vector<CookedLevelData> &levels)
+{
+    size_t bytes = 0;
+    for (const CookedLevelData &level : levels) bytes += level.pixels.size();
+    return bytes;
+}
+
+/**
+ * How close a block-compressed level comes to the RGBA8 it was encoded
+ * from, as PSNR over all four channels. Around 40 dB and up is hard to
+ * tell apart on screen.
+ */
+static double block_psnr(uint32_t format, const CookedLevelData &original, const std::vector<unsigned char> &blocks)
+{
+    std::vector<unsigned char> decoded(original.pixels.size());
+    decode_blocks(format, blocks.data(), original.width, original.height, decoded.data());
+
+    double squared = 0;
+    for (size_t i = 0; i < decoded.size(); i++)
+    {
+        double difference = (double) decoded[i] - original.pixels[i];
+        squared += difference * difference;
+    }
+    if (squared == 0) return INFINITY;
+    return 10.0 * std::log10(255.0 * 255.0 * decoded.size() / squared);
+}
+
+static const char *format_name(uint32_t format)
+{
+    switch (format)
+    {
+        case COOKED_BC1: return "BC1";
+        case COOKED_BC3: return "BC3";
+        case COOKED_BC7: return "BC7";
+    }
+    return "RGBA8";
+}
+
+/**
+ PALETTES
+ */
+static uint32_t pack_texel(const unsigned char *texel)
+{
+    return texel[0] | (texel[1] << 8) | (texel[2] << 16) | ((uint32_t) texel[3] << 24);
+}
+
+static int texel_channel(uint32_t texel, int channel)
+{
+    return (texel >> (channel * 8)) & 0xFF;
+}
+
+/**
+ * Median cut over a level's premultiplied colours, each weighted by how many
+ * texels use it: the box with the widest channel is split at its weighted
+ * median until there are COOKED_PALETTE_SIZE boxes, and each box becomes
+ * its mean. An image with no more colours than that, like a colormapped
+ * PNG, comes back with exactly its own colours.
+ */
+static std::vector<uint32_t> build_palette(const CookedLevelData &level)
+{
+    std::unordered_map<uint32_t, uint32_t> counts;
+    for (size_t i = 0; i < level.pixels.size(); i += 4) counts[pack_texel(&level.pixels[i])]++;
+
+    // Sorted so the same image always cooks to the same palette
+    std::vector<std::pair<uint32_t, uint32_t>> colors(counts.begin(), counts.end());
+    std::sort(colors.begin(), colors.end());
+
+    std::vector<uint32_t> palette;
+    if (colors.size() <= COOKED_PALETTE_SIZE)
+    {
+        for (const auto &color : colors) palette.push_back(color.first);
+        return palette;
+    }
+
+    struct Box {
+        size_t begin, end;
+    };
+    std::vector<Box> boxes = { { 0, colors.size() } };
+
+    while (boxes.size() < COOKED_PALETTE_SIZE)
+    {
+        int widest = -1, widest_channel = 0, widest_extent = 0;
+        for (size_t b = 0; b < boxes.size(); b++)
+        {
+            if (boxes[b].end - boxes[b].begin < 2) continue;
+            for (int channel = 0; channel < 4; channel++)
+            {
+                int low = 255, high = 0;
+                for (size_t i = boxes[b].begin; i < boxes[b].end; i++)
+                {
+                    int value = texel_channel(colors[i].first, channel);
+                    low = std::min(low, value);
+                    high = std::max(high, value);
+                }
+                if (high - low > widest_extent)
+                {
+                    widest = (int) b;
+                    widest_channel = channel;
+                    widest_extent = high - low;
+                }
+            }
+        }
+        if (widest < 0) break;
+
+        Box box = boxes[widest];
+        std::sort(colors.begin() + box.begin, colors.begin() + box.end, [widest_channel](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b) {
+            return texel_channel(a.first, widest_channel) < texel_channel(b.first, widest_channel);
+        });
+
+        uint64_t total = 0, running = 0;
+        for (size_t i = box.begin; i < box.end; i++) total += colors[i].second;
+        size_t split = box.begin + 1;
+        while (split < box.end - 1 && (running += colors[split - 1].second) * 2 < total) split++;
+
+        boxes[widest].end = split;
+        boxes.push_back({ split, box.end });
+    }
+
+    for (const Box &box : boxes)
+    {
+        uint64_t sum[4] = { 0, 0, 0, 0 }, total = 0;
+        for (size_t i = box.begin; i < box.end; i++)
+        {
+            for (int channel = 0; channel < 4; channel++) sum[channel] += (uint64_t) texel_channel(colors[i].first, channel) * colors[i].second;
+            total += colors[i].second;
+        }
+
+        unsigned char mean[4];
+        for (int channel = 0; channel < 4; channel++) mean[channel] = (unsigned char) ((sum[channel] + total / 2) / total);
+        palette.push_back(pack_texel(mean));
+    }
+    return palette;
+}
+
+/**
+ * Replaces every texel of an RGBA8 level by the index of the nearest
+ * palette colour, leaving one byte per texel.
+ */
+static void index_level(CookedLevelData &level, const std::vector<uint32_t> &palette)
+{
+    std::unordered_map<uint32_t, unsigned char> nearest;
+    std::vector<unsigned char> indices(level.width * level.height);
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        uint32_t texel = pack_texel(&level.pixels[i * 4]);
+        auto found = nearest.find(texel);
+        if (found == nearest.end())
+        {
+            int best = 0, best_distance = INT32_MAX;
+            for (size_t entry = 0; entry < palette.size() && best_distance > 0; entry++)
+            {
+                int distance = 0;
+                for (int channel = 0; channel < 4; channel++)
+                {
+                    int difference = texel_channel(texel, channel) - texel_channel(palette[entry], channel);
+                    distance += difference * difference;
+                }
+                if (distance < best_distance)
+                {
+                    best = (int) entry;
+                    best_distance = distance;
+                }
+            }
+            found = nearest.emplace(texel, (unsigned char) best).first;
+        }
+        indices[i] = found->second;
+    }
+
+    level.pixels.swap(indices);
+}
+
+/**
+ * Turns a palette row's hue about the grey axis and scales its brightness.
+ * Both are linear in the colour, so premultiplied entries go through as
+ * they are and only need clamping back under their alpha.
+ */
+static void recolor_palette_row(const unsigned char *source, unsigned char *destination, const PaletteVariant &variant)
+{
+    float angle = variant.hueDegrees * 3.14159265f / 180.0f;
+    float cosine = std::cos(angle), sine = std::sin(angle);
+    float third = (1.0f - cosine) / 3.0f, root = std::sqrt(1.0f / 3.0f) * sine;
+    const float hue[3][3] = {
+        { cosine + third, third - root,   third + root   },
+        { third + root,   cosine + third, third - root   },
+        { third - root,   third + root,   cosine + third },
+    };
+
+    for (uint32_t entry = 0; entry < COOKED_PALETTE_SIZE; entry++)
+    {
+        const unsigned char *from = &source[entry * 4];
+        unsigned char *to = &destination[entry * 4];
+        for (int channel = 0; channel < 3; channel++)
+        {
+            float value = (hue[channel][0] * from[0] + hue[channel][1] * from[1] + hue[channel][2] * from[2]) * variant.brightness;
+            to[channel] = (unsigned char) std::min((float) from[3], std::max(0.0f, value + 0.5f));
+        }
+        to[3] = from[3];
+    }
+}
+
+/**
+ COOKING
+ */
+struct CookTotals {
+    size_t sourceBytes = 0;
+    size_t cookedBytes = 0;
+};
+
+static bool cook_texture(const std::string &source, const std::string &cooked, const ImportSettings &settings, CookTotals *totals)
+{
+    int width, height, number_of_components;
+    unsigned char *image = stbi_load(source.c_str(), &width, &height, &number_of_components, STBI_rgb_alpha);
+    if (image == NULL)
+    {
+        LOG("Unable to load image " << source << ": " << stbi_failure_reason());
+        return false;
+    }
+
+    std::vector<CookedLevelData> levels(1);
+    levels[0].width  = width;
+    levels[0].height = height;
+    levels[0].pixels.assign(image, image + width * height * 4);
+    stbi_image_free(image);
+
+    premultiply_rgba8(levels[0].pixels.data(), width * height);
+
+    uint32_t target_width  = target_extent(width,  settings.quadWidth,  settings.cols);
+    uint32_t target_height = target_extent(height, settings.quadHeight, settings.rows);
+    if (target_width != (uint32_t) width || target_height != (uint32_t) height)
+    {
+        levels[0] = resample(levels[0], target_width, target_height);
+    }
+
+    while (settings.mipmaps && !settings.indexed && (levels.back().width > 1 || levels.back().height > 1))
+    {
+        levels.push_back(downsample(levels.back()));
+    }
+
+    uint32_t flags = COOKED_PREMULTIPLIED;
+    if (settings.linear && !settings.indexed) flags |= COOKED_FILTER_LINEAR | COOKED_WRAP_CLAMP;
+
+    // Row 0 holds the source colours, padded out to a full row; each variant follows
+    std::vector<unsigned char> palette;
+    size_t colors = 0;
+    if (settings.indexed)
+    {
+        std::vector<uint32_t> entries = build_palette(levels[0]);
+        index_level(levels[0], entries);
+        colors = entries.size();
+
+        std::vector<PaletteVariant> variants = palette_variants_for(settings.name);
+        palette.assign((variants.size() + 1) * COOKED_PALETTE_SIZE * 4, 0);
+        for (size_t entry = 0; entry < entries.size(); entry++)
+        {
+            for (int channel = 0; channel < 4; channel++) palette[entry * 4 + channel] = (unsigned char) texel_channel(entries[entry], channel);
+        }
+        for (size_t row = 1; row <= variants.size(); row++)
+        {
+            recolor_palette_row(&palette[0], &palette[row * COOKED_PALETTE_SIZE * 4], variants[row - 1]);
+        }
+    }
+
+    // Compressed last, once every level is final
+    uint32_t format = settings.indexed ? COOKED_INDEX8 : settings.compression;
+    double psnr = 0, bc3_psnr = 0, bc7_psnr = 0;
+    // BC7 has to measure better than BC3 on the base level to be kept
+    if (format == COOKED_BC7)
+    {
+        std::vector<unsigned char> bc3, bc7;
+        encode_blocks(COOKED_BC3, levels[0].pixels.data(), levels[0].width, levels[0].height, bc3);
+        encode_blocks(COOKED_BC7, levels[0].pixels.data(), levels[0].width, levels[0].height, bc7);
+        bc3_psnr = block_psnr(COOKED_BC3, levels[0], bc3);
+        bc7_psnr = block_psnr(COOKED_BC7, levels[0], bc7);
+        if (bc7_psnr <= bc3_psnr) format = COOKED_BC3;
+    }
+    if (is_block_compressed(format))
+    {
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            std::vector<unsigned char> blocks;
+            encode_blocks(format, levels[i].pixels.data(), levels[i].width, levels[i].height, blocks);
+            if (i == 0) psnr = block_psnr(format, levels[0], blocks);
+            levels[i].pixels.swap(blocks);
+        }
+    }
+
+    if (!write_cooked_texture(cooked, format, flags, hash_import_settings(settings), levels, palette))
+    {
+        LOG("Unable to write " << cooked);
+        return false;
+    }
+
+    size_t source_bytes = (size_t) width * height * 4;
+    size_t cooked_bytes = level_bytes(levels) + palette.size();
+    totals->sourceBytes += source_bytes;
+    totals->cookedBytes += cooked_bytes;
+
+    LOG("Cooked " << source << " -> " << cooked << " (" << width << "x" << height << " -> "
+        << target_width << "x" << target_height << ", " << levels.size() << " levels, "
+        << source_bytes / 1024 << " KB -> " << cooked_bytes / 1024 << " KB)");
+    if (settings.indexed)
+    {
+        LOG("    indexed: " << colors << " colours, " << palette.size() / (COOKED_PALETTE_SIZE * 4) << " palette rows");
+    }
+    else if (is_block_compressed(format))
+    {
+        LOG("    " << format_name(format) << ": " << psnr << " dB PSNR against RGBA8");
+        if (settings.compression == COOKED_BC7)
+        {
+            LOG("    asked for BC7: " << bc7_psnr << " dB as BC7, " << bc3_psnr << " dB as BC3");
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string assets = argc > 1 ? argv[1] : "assets";
+    if (assets.back() != '/') assets += '/';
+
+    DIR *directory = opendir(assets.c_str());
+    if (directory == NULL)
+    {
+        LOG("Unable to open " << assets);
+        return 1;
+    }
+
+    mkdir((assets + COOKED_TEXTURE_DIRECTORY).c_str(), 0755);
+
+    int cooked = 0, skipped = 0, failed = 0;
+    CookTotals totals;
+    while (struct dirent *entry = readdir(directory))
+    {
+        std::string name = entry->d_name;
+        if (!has_image_extension(name)) continue;
+
+        std::string source = assets + name;
+        std::string target = cooked_texture_path(source);
+        const ImportSettings &settings = import_settings_for(name);
+
+        if (is_up_to_date(source, target, hash_import_settings(settings)))
+        {
+            skipped++;
+            continue;
+        }
+
+        if (cook_texture(source, target, settings, &totals)) cooked++;
+        else failed++;
+    }
+    closedir(directory);
+
+    LOG(cooked << " cooked, " << skipped << " up to date, " << failed << " failed");
+    if (cooked > 0)
+    {
+        LOG("Texture memory for cooked assets: " << totals.sourceBytes / 1024 << " KB at source size, "
+            << totals.cookedBytes / 1024 << " KB cooked (mips included)");
+    }
+    return failed == 0 ? 0 : 1;
+}